@@ -0,0 +1,48 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "types.h"
+
+// probes for the cycle benchmark (tools/benchmark.py), built only in benchmark configuration
+// each probe writes its id to benchmark_marker, the simulator logs the writes with cycle counter
+// and the script pairs begins with ends, the probe itself costs 2 cycles (MOVLW, MOVWF)
+
+enum benchmark_probe_t
+{
+	BENCHMARK_ISR = 1,
+	BENCHMARK_FRAME,
+	BENCHMARK_UI_UPDATE,
+	BENCHMARK_DISPLAY_UPDATE,
+	BENCHMARK_STATIONS_QUEUE_UPDATE,
+	BENCHMARK_PROGRAMS_CHECK,
+	BENCHMARK_RECEIVE_PACKET
+};
+
+#ifdef BENCHMARK
+
+extern volatile uint8_t benchmark_marker;
+
+#define BENCHMARK_BEGIN(probe) (benchmark_marker = (uint8_t)((probe) << 1))
+#define BENCHMARK_END(probe) (benchmark_marker = (uint8_t)(((probe) << 1) | 1))
+
+#else
+
+#define BENCHMARK_BEGIN(probe) ((void)0)
+#define BENCHMARK_END(probe) ((void)0)
+
+#endif
@@ -0,0 +1,73 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "calendar.h"
+
+// days of common year before the first day of month
+static const uint16_t month_start_table[13] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365 };
+
+bool calendar_leap_year(uint8_t year)
+{
+	// every 4th year is leap in 2000-2099 range (2000 is leap too)
+	return ((year & 3) == 0);
+}
+
+uint8_t calendar_month_days(uint8_t year, uint8_t month)
+{
+	uint8_t days = (uint8_t)(month_start_table[month] - month_start_table[month - 1]);
+	if (month == 2 && calendar_leap_year(year))
+		days++;
+	return days;
+}
+
+uint16_t calendar_year_day(uint8_t year, uint8_t month, uint8_t day)
+{
+	uint16_t year_day = month_start_table[month - 1] + day - 1;
+	if (month > 2 && calendar_leap_year(year))
+		year_day++;
+	return year_day;
+}
+
+uint16_t calendar_epoch_day(uint8_t year, uint8_t month, uint8_t day)
+{
+	// 365 days for every year since 2000, plus a day for every leap year before this one
+	return (uint16_t)year * 365 + ((year + 3) >> 2) + calendar_year_day(year, month, day);
+}
+
+uint8_t calendar_weekday(uint16_t epoch_day)
+{
+	// 2000-01-01 was Saturday
+	return (epoch_day + 5) % 7;
+}
+
+uint16_t calendar_legacy_year_day(uint8_t year, uint8_t month, uint8_t day)
+{
+	// year day as older firmware counted it, every previous month was added with the length of this one
+	// and the leap year was tested on BCD year, so only years ending by 0, 4 and 8 were leap
+	uint16_t year_day = (uint16_t)(month_start_table[month] - month_start_table[month - 1]) * (month - 1) + day - 1;
+	if (month > 2 && ((year % 10) & 3) == 0)
+		year_day++;
+	return year_day;
+}
+
+uint8_t calendar_migrate_offset(uint8_t offset, uint8_t days, uint8_t year, uint8_t month, uint8_t day)
+{
+	// interval offset counted from the legacy year day moved to the epoch day, phase of this day is kept
+	uint8_t period = days + 1;
+	uint8_t epoch_phase = calendar_epoch_day(year, month, day) % period;
+	uint8_t legacy_phase = calendar_legacy_year_day(year, month, day) % period;
+	return (offset + epoch_phase + period - legacy_phase) % period;
+}
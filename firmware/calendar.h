@@ -0,0 +1,30 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "types.h"
+
+// dates are binary, year 0-99 means 2000-2099, month 1-12, day 1-31
+// epoch day is the number of days since 2000-01-01, weekday 0-6 is Monday-Sunday
+
+bool calendar_leap_year(uint8_t year);
+uint8_t calendar_month_days(uint8_t year, uint8_t month);
+uint16_t calendar_year_day(uint8_t year, uint8_t month, uint8_t day);
+uint16_t calendar_epoch_day(uint8_t year, uint8_t month, uint8_t day);
+uint8_t calendar_weekday(uint16_t epoch_day);
+uint16_t calendar_legacy_year_day(uint8_t year, uint8_t month, uint8_t day);
+uint8_t calendar_migrate_offset(uint8_t offset, uint8_t days, uint8_t year, uint8_t month, uint8_t day);
@@ -16,6 +16,35 @@
 
 #include "controls.h"
 
+volatile uint16_t controls_time = 0;
+
+static controls_event_t events[CONTROLS_EVENTS];
+static volatile uint8_t events_head = 0;
+static volatile uint8_t events_tail = 0;
+
+// debounced state of buttons and the counters of its change
+static volatile uint8_t buttons_state = 0;
+static uint8_t buttons_sample = 0;
+static uint8_t buttons_stable = 0;
+static uint16_t buttons_hold = 0;
+static uint8_t buttons_interval = 0;
+static uint8_t buttons_countdown = 0;
+
+// debounced position of rotary controller
+static volatile uint8_t rotary_state = FUNCTION_NONE;
+static uint8_t rotary_sample = FUNCTION_NONE;
+static uint8_t rotary_stable = 0;
+
+// timer4 is stopped while nothing's held and the rotary controller is in place
+static volatile bool scan_parked = false;
+
+static void scan_start(void);
+static void scan_park(void);
+static uint8_t scan_selection(void);
+static bool selection_kept(uint8_t selection);
+static uint8_t scan_buttons(void);
+static void post_event(uint8_t type, uint8_t value);
+
 void controls_init(void)
 {
 	PADCFG1bits.REPU = 1;
@@ -24,9 +53,205 @@ void controls_init(void)
 	TRISA |= 0b00010110;
 	TRISF |= 0b10000000;
 	TRISG |= 0b00010000;
+
+	controls_resume();
+}
+
+void controls_resume(void)
+{
+	// forget the state before the sleep, eventually held button is pressed again
+	events_head = events_tail = 0;
+	buttons_state = buttons_sample = buttons_stable = 0;
+	rotary_state = rotary_sample = FUNCTION_NONE;
+	rotary_stable = 0;
+
+	// configure timer4 to 1:16 pre-scaler, 1:4 post-scaler, 8ms period
+	PR4 = _XTAL_FREQ / 4 / 16 / 4 / (1000 / CONTROLS_SCAN_PERIOD) - 1;
+	scan_start();
+	PIE5bits.TMR4IE = 1;
+}
+
+void controls_wake(void)
+{
+	// INT1 falling edge, a button was pressed while the scan was parked
+	scan_start();
+}
+
+void controls_frame(void)
+{
+	if (!scan_parked)
+		return;
+
+	// rotary controller can't wake the core, its contact is checked every frame, RB1 drives the row only when it's
+	// the selected one (buttons are driven low meanwhile, so a press can't short it)
+	uint8_t row = rotary_state / 3;
+	TRISBbits.TRISB1 = (row != 2);
+	bool kept = selection_kept(rotary_state);
+	PORTBbits.RB1 = 1;
+	TRISBbits.TRISB1 = 1;
+
+	if (!kept)
+		scan_start();
+}
+
+static void scan_start(void)
+{
+	INTCON3bits.INT1IE = 0;
+
+	// buttons back to inputs read through RB1
+	TRISA |= 0b00010110;
+	TRISF |= 0b10000000;
+	TRISG |= 0b00010000;
+	TRISBbits.TRISB1 = 0;
+	INTCON2bits.RBPU = 1;
+
+	TMR4 = 0;
+	T4CON = 0b00011110;
+	PIR5bits.TMR4IF = 0;
+	scan_parked = false;
+}
+
+static void scan_park(void)
+{
+	T4CON = 0;
+	scan_parked = true;
+
+	// buttons are wired between RB1 and their inputs, the same way the sleep waits for a press the inputs are
+	// driven low and RB1 is pulled up, so a press is INT1 falling edge
+	LATA &= ~0b00010110;
+	LATF &= ~0b10000000;
+	LATG &= ~0b00010000;
+	TRISA &= ~0b00010110;
+	TRISF &= ~0b10000000;
+	TRISG &= ~0b00010000;
+	PORTBbits.RB1 = 1;
+	TRISBbits.TRISB1 = 1;
+	INTCON2bits.RBPU = 0;
+	INTCON2bits.INTEDG1 = 0;
+	INTCON3bits.INT1IF = 0;
+	INTCON3bits.INT1IE = 1;
+
+	// pressed between the last scan and the edge arming, there's no edge to come
+	if (!PORTBbits.RB1)
+		scan_start();
+}
+
+void controls_scan(void)
+{
+	++controls_time;
+
+	// buttons are debounced as a whole, so the combinations are reported at once
+	uint8_t sample = scan_buttons();
+	if (sample != buttons_sample)
+	{
+		buttons_sample = sample;
+		buttons_stable = 0;
+	}
+	else if (buttons_stable < CONTROLS_DEBOUNCE)
+	{
+		if (++buttons_stable == CONTROLS_DEBOUNCE && sample != buttons_state)
+		{
+			uint8_t released = buttons_state & ~sample;
+			uint8_t pressed = sample & ~buttons_state;
+			buttons_state = sample;
+
+			if (released)
+				post_event(CONTROLS_EVENT_RELEASE, released);
+			if (pressed)
+			{
+				post_event(CONTROLS_EVENT_PRESS, sample);
+
+				buttons_hold = 0;
+				buttons_interval = CONTROLS_REPEAT_INTERVAL;
+				buttons_countdown = CONTROLS_REPEAT_DELAY;
+			}
+		}
+	}
+
+	if (buttons_state)
+	{
+		if (buttons_hold < UINT16_MAX && ++buttons_hold == CONTROLS_LONG_PRESS)
+			post_event(CONTROLS_EVENT_LONG, buttons_state);
+
+		// repeat while held, every time a bit faster
+		if (--buttons_countdown == 0)
+		{
+			post_event(CONTROLS_EVENT_REPEAT, buttons_state);
+
+			if (buttons_interval > CONTROLS_REPEAT_INTERVAL_MIN + CONTROLS_REPEAT_ACCELERATION)
+				buttons_interval -= CONTROLS_REPEAT_ACCELERATION;
+			else
+				buttons_interval = CONTROLS_REPEAT_INTERVAL_MIN;
+			buttons_countdown = buttons_interval;
+		}
+	}
+
+	// rotary controller is scanned whole only when it's not in the last known position anymore
+	if (rotary_state != FUNCTION_NONE && selection_kept(rotary_state))
+	{
+		rotary_sample = rotary_state;
+		rotary_stable = 0;
+
+		// nothing's held or settling, so the scan isn't needed till INT1 or the frame check starts it again
+		if (!buttons_state && !buttons_sample && buttons_stable == CONTROLS_DEBOUNCE)
+			scan_park();
+		return;
+	}
+
+	sample = scan_selection();
+	if (sample != rotary_sample)
+	{
+		rotary_sample = sample;
+		rotary_stable = 0;
+	}
+	else if (rotary_stable < CONTROLS_DEBOUNCE && ++rotary_stable == CONTROLS_DEBOUNCE && sample != FUNCTION_NONE)
+	{
+		rotary_state = sample;
+		post_event(CONTROLS_EVENT_SELECTION, sample);
+	}
+}
+
+bool controls_event(controls_event_t* event)
+{
+	uint8_t tail = events_tail;
+	if (tail == events_head)
+		return false;
+
+	*event = events[tail];
+	events_tail = (tail + 1) & (CONTROLS_EVENTS - 1);
+	return true;
+}
+
+bool controls_pending(void)
+{
+	return (events_tail != events_head);
+}
+
+uint8_t controls_buttons(void)
+{
+	return buttons_state;
 }
 
 uint8_t controls_selection(void)
+{
+	return rotary_state;
+}
+
+static void post_event(uint8_t type, uint8_t value)
+{
+	uint8_t head = events_head;
+	uint8_t next = (head + 1) & (CONTROLS_EVENTS - 1);
+	if (next == events_tail)
+		// queue is full, the event is lost
+		return;
+
+	events[head].type = type;
+	events[head].value = value;
+	events[head].time = controls_time;
+	events_head = next;
+}
+
+static uint8_t scan_selection(void)
 {
 	uint8_t bits;
 
@@ -69,7 +294,22 @@ uint8_t controls_selection(void)
 	return FUNCTION_NONE;
 }
 
-uint8_t controls_buttons(void)
+static bool selection_kept(uint8_t selection)
+{
+	if (selection > FUNCTION_OFF)
+		return false;
+
+	// drive only the row of the selection and check its contact is still closed
+	uint8_t row = selection / 3;
+	PORTBbits.RB1 = (row != 2);
+	PORTBbits.RB2 = (row != 1);
+	PORTBbits.RB3 = (row != 0);
+
+	static const uint8_t columns[3] = { 0b110, 0b101, 0b011 };
+	return ((PORTE & 7) == columns[selection % 3]);
+}
+
+static uint8_t scan_buttons(void)
 {
 	PORTBbits.RB1 = 1;
 
@@ -18,6 +18,22 @@
 
 #include "types.h"
 
+// buttons and rotary controller are scanned by timer4 interrupt only while a button is held or anything settles,
+// its 125 wakeups a second would take most of the idle saving, otherwise a press wakes the core by INT1 and
+// the rotary controller position is checked by the frame interrupt
+#define CONTROLS_SCAN_PERIOD			8	// ms
+#define CONTROLS_DEBOUNCE				3	// scans the state has to be stable
+
+// held buttons are repeated after the delay, each repeat comes a bit sooner down to the minimal interval
+#define CONTROLS_REPEAT_DELAY			(500 / CONTROLS_SCAN_PERIOD)
+#define CONTROLS_REPEAT_INTERVAL		(200 / CONTROLS_SCAN_PERIOD)
+#define CONTROLS_REPEAT_INTERVAL_MIN	(48 / CONTROLS_SCAN_PERIOD)
+#define CONTROLS_REPEAT_ACCELERATION	(16 / CONTROLS_SCAN_PERIOD)
+#define CONTROLS_LONG_PRESS				(3000 / CONTROLS_SCAN_PERIOD)
+
+// size of the events queue, power of 2
+#define CONTROLS_EVENTS 8
+
 enum selection_t
 {
 	// rotary controller functions
@@ -47,6 +63,32 @@ enum buttons_t
 	LEFT = 16
 };
 
+enum controls_event_type_t
+{
+	CONTROLS_EVENT_PRESS,
+	CONTROLS_EVENT_REPEAT,
+	CONTROLS_EVENT_LONG,
+	CONTROLS_EVENT_RELEASE,
+	CONTROLS_EVENT_SELECTION
+};
+
+typedef struct
+{
+	uint8_t type;
+	uint8_t value; // buttons mask or selection
+	uint16_t time; // scan ticks (they stop while the scan is parked)
+} controls_event_t;
+
+extern volatile uint16_t controls_time;
+
 void controls_init(void);
+void controls_resume(void);
+void controls_scan(void);
+void controls_wake(void);
+void controls_frame(void);
+
+bool controls_event(controls_event_t* event);
+bool controls_pending(void);
+
 uint8_t controls_selection(void);
 uint8_t controls_buttons(void);
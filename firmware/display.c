@@ -15,197 +15,65 @@
 */
 
 #include "display.h"
-
-#define LCD_SEGMENT(address, bit) ((uint8_t)(address - 0xF66) | (bit << 5))
-#define LCD_SEGMENT_NONE() 0xFF
-
-static const uint8_t lcd_segments_table[] =
-{
-	// digit 0
-	LCD_SEGMENT(0xF6A, 4),
-	LCD_SEGMENT(0xF6A, 3),
-	LCD_SEGMENT(0xF70, 4),
-	LCD_SEGMENT(0xF70, 3),
-	LCD_SEGMENT(0xF76, 3),
-	LCD_SEGMENT(0xF76, 4),
-	LCD_SEGMENT(0xF7C, 3),
-	LCD_SEGMENT_NONE(),
-
-	// digit 1
-	LCD_SEGMENT(0xF6A, 2),
-	LCD_SEGMENT(0xF6B, 4),
-	LCD_SEGMENT(0xF70, 2),
-	LCD_SEGMENT(0xF71, 4),
-	LCD_SEGMENT(0xF77, 4),
-	LCD_SEGMENT(0xF76, 2),
-	LCD_SEGMENT(0xF7D, 4),
-	LCD_SEGMENT_NONE(),
-
-	// digit 2
-	LCD_SEGMENT(0xF6A, 6),
-	LCD_SEGMENT(0xF6A, 5),
-	LCD_SEGMENT(0xF70, 6),
-	LCD_SEGMENT(0xF70, 5),
-	LCD_SEGMENT(0xF76, 5),
-	LCD_SEGMENT(0xF76, 6),
-	LCD_SEGMENT(0xF7C, 5),
-	LCD_SEGMENT_NONE(),
-
-	// digit 3
-	LCD_SEGMENT(0xF68, 3),
-	LCD_SEGMENT(0xF6A, 7),
-	LCD_SEGMENT(0xF6E, 3),
-	LCD_SEGMENT(0xF70, 7),
-	LCD_SEGMENT(0xF76, 7),
-	LCD_SEGMENT(0xF74, 3),
-	LCD_SEGMENT(0xF7C, 7),
-	LCD_SEGMENT_NONE(),
-
-	// digit 4
-	LCD_SEGMENT(0xF6B, 2),
-	LCD_SEGMENT(0xF6B, 0),
-	LCD_SEGMENT(0xF71, 2),
-	LCD_SEGMENT(0xF71, 0),
-	LCD_SEGMENT(0xF77, 0),
-	LCD_SEGMENT(0xF77, 2),
-	LCD_SEGMENT(0xF7D, 0),
-	LCD_SEGMENT_NONE(),
-
-	// digit 5
-	LCD_SEGMENT(0xF68, 4),
-	LCD_SEGMENT(0xF6B, 3),
-	LCD_SEGMENT(0xF6E, 4),
-	LCD_SEGMENT(0xF71, 3),
-	LCD_SEGMENT(0xF77, 3),
-	LCD_SEGMENT(0xF74, 4),
-	LCD_SEGMENT(0xF7D, 3),
-	LCD_SEGMENT_NONE(),
-
-	// drops
-	LCD_SEGMENT(0xF78, 1),
-	LCD_SEGMENT(0xF78, 2),
-	LCD_SEGMENT(0xF78, 3),
-	LCD_SEGMENT(0xF78, 4),
-	LCD_SEGMENT(0xF78, 5),
-	LCD_SEGMENT(0xF78, 6),
-	LCD_SEGMENT(0xF78, 7),
-	LCD_SEGMENT(0xF7C, 1),
-
-	// drop stops
-	LCD_SEGMENT(0xF72, 1),
-	LCD_SEGMENT(0xF72, 2),
-	LCD_SEGMENT(0xF72, 3),
-	LCD_SEGMENT(0xF72, 4),
-	LCD_SEGMENT(0xF72, 5),
-	LCD_SEGMENT(0xF72, 6),
-	LCD_SEGMENT(0xF72, 7),
-	LCD_SEGMENT(0xF76, 1),
-
-	// weekdays
-	LCD_SEGMENT(0xF6C, 1),
-	LCD_SEGMENT(0xF6C, 2),
-	LCD_SEGMENT(0xF6C, 3),
-	LCD_SEGMENT(0xF6C, 4),
-	LCD_SEGMENT(0xF6C, 5),
-	LCD_SEGMENT(0xF6C, 6),
-	LCD_SEGMENT(0xF6C, 7),
-	LCD_SEGMENT_NONE(),
-
-	// bars
-	LCD_SEGMENT(0xF66, 0),
-	LCD_SEGMENT(0xF6C, 0),
-	LCD_SEGMENT(0xF72, 0),
-	LCD_SEGMENT(0xF7D, 7),
-	LCD_SEGMENT(0xF77, 7),
-	LCD_SEGMENT(0xF71, 7),
-	LCD_SEGMENT(0xF6B, 7),
-	LCD_SEGMENT(0xF6B, 6),
-	LCD_SEGMENT(0xF71, 6),
-	LCD_SEGMENT(0xF77, 6),
-	LCD_SEGMENT(0xF7D, 6),
-	LCD_SEGMENT(0xF7D, 5),
-	LCD_SEGMENT(0xF77, 5),
-	LCD_SEGMENT(0xF71, 5),
-	LCD_SEGMENT(0xF6B, 5),
-	LCD_SEGMENT_NONE(),
-
-	// time comma, 24H, AM, PM, calendar 1-12, calendar 1-31, odd, even
-	LCD_SEGMENT(0xF7A, 3),
-	LCD_SEGMENT(0xF6E, 6),
-	LCD_SEGMENT(0xF68, 5),
-	LCD_SEGMENT(0xF68, 6),
-	LCD_SEGMENT(0xF7C, 4),
-	LCD_SEGMENT(0xF7A, 4),
-	LCD_SEGMENT(0xF70, 1),
-	LCD_SEGMENT(0xF78, 0),
-
-	// cycle, soak, umbrella, spray, spray stop, sand clock, alarm clock, percent
-	LCD_SEGMENT(0xF7A, 5),
-	LCD_SEGMENT(0xF7A, 6),
-	LCD_SEGMENT(0xF7D, 2),
-	LCD_SEGMENT(0xF74, 6),
-	LCD_SEGMENT(0xF74, 5),
-	LCD_SEGMENT(0xF7C, 6),
-	LCD_SEGMENT(0xF7C, 2),
-	LCD_SEGMENT(0xF6E, 5),
-};
+#include "display_layout.h"
+#include "profiler.h"
 
 static union lcd_segments_map_t
 {
 	struct
 	{
-		uint8_t digit_0_b:1;
-		uint8_t digit_0_br:1;
-		uint8_t digit_0_bl:1;
-		uint8_t digit_0_m:1;
-		uint8_t digit_0_tr:1;
-		uint8_t digit_0_tl:1;
 		uint8_t digit_0_t:1;
+		uint8_t digit_0_tl:1;
+		uint8_t digit_0_tr:1;
+		uint8_t digit_0_m:1;
+		uint8_t digit_0_bl:1;
+		uint8_t digit_0_br:1;
+		uint8_t digit_0_b:1;
 		uint8_t :1;
 
-		uint8_t digit_1_b:1;
-		uint8_t digit_1_br:1;
-		uint8_t digit_1_bl:1;
-		uint8_t digit_1_m:1;
-		uint8_t digit_1_tr:1;
-		uint8_t digit_1_tl:1;
 		uint8_t digit_1_t:1;
+		uint8_t digit_1_tl:1;
+		uint8_t digit_1_tr:1;
+		uint8_t digit_1_m:1;
+		uint8_t digit_1_bl:1;
+		uint8_t digit_1_br:1;
+		uint8_t digit_1_b:1;
 		uint8_t :1;
 
-		uint8_t digit_2_b:1;
-		uint8_t digit_2_br:1;
-		uint8_t digit_2_bl:1;
-		uint8_t digit_2_m:1;
-		uint8_t digit_2_tr:1;
-		uint8_t digit_2_tl:1;
 		uint8_t digit_2_t:1;
+		uint8_t digit_2_tl:1;
+		uint8_t digit_2_tr:1;
+		uint8_t digit_2_m:1;
+		uint8_t digit_2_bl:1;
+		uint8_t digit_2_br:1;
+		uint8_t digit_2_b:1;
 		uint8_t :1;
 
-		uint8_t digit_3_b:1;
-		uint8_t digit_3_br:1;
-		uint8_t digit_3_bl:1;
-		uint8_t digit_3_m:1;
-		uint8_t digit_3_tr:1;
-		uint8_t digit_3_tl:1;
 		uint8_t digit_3_t:1;
+		uint8_t digit_3_tl:1;
+		uint8_t digit_3_tr:1;
+		uint8_t digit_3_m:1;
+		uint8_t digit_3_bl:1;
+		uint8_t digit_3_br:1;
+		uint8_t digit_3_b:1;
 		uint8_t :1;
 
-		uint8_t digit_4_b:1;
-		uint8_t digit_4_br:1;
-		uint8_t digit_4_bl:1;
-		uint8_t digit_4_m:1;
-		uint8_t digit_4_tr:1;
-		uint8_t digit_4_tl:1;
 		uint8_t digit_4_t:1;
+		uint8_t digit_4_tl:1;
+		uint8_t digit_4_tr:1;
+		uint8_t digit_4_m:1;
+		uint8_t digit_4_bl:1;
+		uint8_t digit_4_br:1;
+		uint8_t digit_4_b:1;
 		uint8_t :1;
 
-		uint8_t digit_5_b:1;
-		uint8_t digit_5_br:1;
-		uint8_t digit_5_bl:1;
-		uint8_t digit_5_m:1;
-		uint8_t digit_5_tr:1;
-		uint8_t digit_5_tl:1;
 		uint8_t digit_5_t:1;
+		uint8_t digit_5_tl:1;
+		uint8_t digit_5_tr:1;
+		uint8_t digit_5_m:1;
+		uint8_t digit_5_bl:1;
+		uint8_t digit_5_br:1;
+		uint8_t digit_5_b:1;
 		uint8_t :1;
 
 		uint8_t drop_1:1;
@@ -289,7 +157,27 @@ static union lcd_segments_map_t
 }
 lcd_segments_map = {};
 
+// map shown by the last update, the update is skipped if nothing has changed since
+static uint8_t lcd_segments_shown[sizeof(lcd_segments_map)];
+static bool lcd_segments_dirty = true;
+
+// bits of each LCDDATA register to set and clear, composed from the changed segments only, zeroed by the write
+static uint8_t lcd_data_set[LCD_DATA_REGISTERS];
+static uint8_t lcd_data_clear[LCD_DATA_REGISTERS];
+
+static uint8_t lcd_power_level = DISPLAY_POWER_FULL;
+
 void display_init(void)
+{
+	display_resume();
+
+	display_all();
+	display_update();
+	hal_delay_ms(500);
+	display_clear();
+}
+
+void display_resume(void)
 {
 	// LCDEN = 1, SLPEN = 1, CS = 0b11, LMUX = 0b11
 	LCDCON = 0b11001111;
@@ -311,29 +199,105 @@ void display_init(void)
 	LCDSE4 = 0b11111110;
 	LCDSE5 = 0b11111101;
 
-	display_all();
-	display_update();
-	__delay_ms(500);
-	display_clear();
+	// write whole map on the next update
+	lcd_segments_dirty = true;
+
+	lcd_power_level = DISPLAY_POWER_FULL;
+}
+
+void display_power(uint8_t level)
+{
+	if (level == lcd_power_level)
+		return;
+
+	if (!LCDPSbits.WA)
+		// pre-scaler can't be written during the frame update, try it next time
+		return;
+
+	lcd_power_level = level;
+
+	switch (level)
+	{
+		case DISPLAY_POWER_FULL:
+			// maximum contrast, ladder in high power mode all the time, full frame rate
+			LCDREFbits.LCDCST = 0b000;
+			LCDRL = 0b11110000;
+			LCDPSbits.LP = 0;
+			break;
+
+		case DISPLAY_POWER_IDLE:
+			// slightly lower contrast, ladder in high power mode only for 3 clocks after each transition, half frame rate
+			LCDREFbits.LCDCST = 0b001;
+			LCDRL = 0b11010011;
+			LCDPSbits.LP = 1;
+			break;
+
+		case DISPLAY_POWER_LOW:
+			// lower contrast, ladder in medium power mode for 2 clocks after each transition, half frame rate
+			LCDREFbits.LCDCST = 0b010;
+			LCDRL = 0b10010010;
+			LCDPSbits.LP = 1;
+			break;
+	}
 }
 
 void display_update(void)
 {
-	uint8_t* map_address = (uint8_t*)&lcd_segments_map;
-	for (char n = 0; n < sizeof(lcd_segments_table); ++n)
+	PROFILER_BEGIN(PROFILER_DISPLAY_UPDATE);
+
+	const uint8_t* map_address = (const uint8_t*)&lcd_segments_map;
+
+	bool changed = false;
+	for (uint8_t n = 0; n < sizeof(lcd_segments_map); ++n)
 	{
-		uint8_t segment = lcd_segments_table[n];
-		if (segment == 0xFF)
+		// after the resume all segments are written again
+		uint8_t bits = map_address[n];
+		uint8_t diff = lcd_segments_dirty ? 0xFF : (uint8_t)(bits ^ lcd_segments_shown[n]);
+		if (!diff)
 			continue;
 
-		uint8_t* address = (uint8_t*)(0xF66 + (segment & 0x1F));
-		uint8_t mask = (uint8_t)(1 << (segment >> 5));
+		lcd_segments_shown[n] = bits;
+		changed = true;
+
+		// only the changed bits of the map byte go to the masks of their registers
+		const uint8_t* segment = &lcd_segments_table[n << 3];
+		const uint8_t* mask = &lcd_segments_masks[n << 3];
+		for (; diff; diff >>= 1, bits >>= 1, ++segment, ++mask)
+		{
+			if (!(diff & 1) || *segment == 0xFF)
+				continue;
+
+			if (bits & 1)
+				lcd_data_set[*segment & 0x1F] |= *mask;
+			else
+				lcd_data_clear[*segment & 0x1F] |= *mask;
+		}
+	}
+
+	if (!changed)
+	{
+		// same frame as the last one
+		PROFILER_END(PROFILER_DISPLAY_UPDATE);
+		return;
+	}
+
+	lcd_segments_dirty = false;
 
-		if (map_address[n >> 3] & (1 << (n & 0x07)))
-			*address |= mask;
-		else
-			*address &= ~mask;
+	// each register with a changed segment is written just once
+	volatile uint8_t* address = HAL_LCD_DATA;
+	for (uint8_t n = 0; n < LCD_DATA_REGISTERS; ++n)
+	{
+		uint8_t set = lcd_data_set[n];
+		uint8_t clear = lcd_data_clear[n];
+		if (!(set | clear))
+			continue;
+
+		address[n] = (uint8_t)((address[n] & ~clear) | set);
+		lcd_data_set[n] = 0;
+		lcd_data_clear[n] = 0;
 	}
+
+	PROFILER_END(PROFILER_DISPLAY_UPDATE);
 }
 
 void display_clear(void)
@@ -350,42 +314,16 @@ void display_all(void)
 
 void display_digit(uint8_t position, uint8_t number)
 {
-	uint8_t bits = 0;
-	switch (number)
-	{
-		// b, br, bl, m, tr, tl, t
-		case 0:
-			bits = 0b01110111;
-			break;
-		case 1:
-			bits = 0b00100100;
-			break;
-		case 2:
-			bits = 0b01011101;
-			break;
-		case 3:
-			bits = 0b01101101;
-			break;
-		case 4:
-			bits = 0b00101110;
-			break;
-		case 5:
-			bits = 0b01101011;
-			break;
-		case 6:
-			bits = 0b01111011;
-			break;
-		case 7:
-			bits = 0b00100101;
-			break;
-		case 8:
-			bits = 0b01111111;
-			break;
-		case 9:
-			bits = 0b01101111;
-			break;
-	}
-	display_digit_segments(position, bits);
+	display_digit_segments(position, (number < 10) ? lcd_font['0' - LCD_FONT_FIRST + number] : 0);
+}
+void display_char(uint8_t position, char c)
+{
+	display_digit_segments(position, (c >= LCD_FONT_FIRST && c <= LCD_FONT_LAST) ? lcd_font[c - LCD_FONT_FIRST] : 0);
+}
+void display_text(uint8_t position, const char* text)
+{
+	while (*text && position < 6)
+		display_char(position++, *text++);
 }
 void display_digit_segments(uint8_t position, uint8_t bits)
 {
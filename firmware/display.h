@@ -42,13 +42,24 @@ enum other_icons_t
 	ICON_PERCENT = 128
 };
 
+enum display_power_t
+{
+	DISPLAY_POWER_FULL,
+	DISPLAY_POWER_IDLE,
+	DISPLAY_POWER_LOW
+};
+
 void display_init(void);
+void display_resume(void);
+void display_power(uint8_t level);
 void display_update(void);
 
 void display_all(void);
 void display_clear(void);
 
 void display_digit(uint8_t position, uint8_t bits);
+void display_char(uint8_t position, char c);
+void display_text(uint8_t position, const char* text);
 void display_digit_segments(uint8_t position, uint8_t bits);
 void display_bars(uint16_t bits);
 void display_weekdays(uint8_t bits);
@@ -0,0 +1,373 @@
+// generated by tools/lcd_layout.py from display.layout, do not edit
+
+#pragma once
+
+#include "types.h"
+
+#define LCD_SEGMENT(data, bit) ((uint8_t)(data) | ((bit) << 5))
+#define LCD_SEGMENT_NONE() 0xFF
+
+#define LCD_DATA_REGISTERS 24
+
+#define LCD_FONT_FIRST ' '
+#define LCD_FONT_LAST 'z'
+
+// LCDDATA register and bit of every display map bit
+static const uint8_t lcd_segments_table[] =
+{
+	// digit_0
+	LCD_SEGMENT(4, 4), // t
+	LCD_SEGMENT(4, 3), // tl
+	LCD_SEGMENT(10, 4), // tr
+	LCD_SEGMENT(10, 3), // m
+	LCD_SEGMENT(16, 3), // bl
+	LCD_SEGMENT(16, 4), // br
+	LCD_SEGMENT(22, 3), // b
+	LCD_SEGMENT_NONE(),
+
+	// digit_1
+	LCD_SEGMENT(4, 2), // t
+	LCD_SEGMENT(5, 4), // tl
+	LCD_SEGMENT(10, 2), // tr
+	LCD_SEGMENT(11, 4), // m
+	LCD_SEGMENT(17, 4), // bl
+	LCD_SEGMENT(16, 2), // br
+	LCD_SEGMENT(23, 4), // b
+	LCD_SEGMENT_NONE(),
+
+	// digit_2
+	LCD_SEGMENT(4, 6), // t
+	LCD_SEGMENT(4, 5), // tl
+	LCD_SEGMENT(10, 6), // tr
+	LCD_SEGMENT(10, 5), // m
+	LCD_SEGMENT(16, 5), // bl
+	LCD_SEGMENT(16, 6), // br
+	LCD_SEGMENT(22, 5), // b
+	LCD_SEGMENT_NONE(),
+
+	// digit_3
+	LCD_SEGMENT(2, 3), // t
+	LCD_SEGMENT(4, 7), // tl
+	LCD_SEGMENT(8, 3), // tr
+	LCD_SEGMENT(10, 7), // m
+	LCD_SEGMENT(16, 7), // bl
+	LCD_SEGMENT(14, 3), // br
+	LCD_SEGMENT(22, 7), // b
+	LCD_SEGMENT_NONE(),
+
+	// digit_4
+	LCD_SEGMENT(5, 2), // t
+	LCD_SEGMENT(5, 0), // tl
+	LCD_SEGMENT(11, 2), // tr
+	LCD_SEGMENT(11, 0), // m
+	LCD_SEGMENT(17, 0), // bl
+	LCD_SEGMENT(17, 2), // br
+	LCD_SEGMENT(23, 0), // b
+	LCD_SEGMENT_NONE(),
+
+	// digit_5
+	LCD_SEGMENT(2, 4), // t
+	LCD_SEGMENT(5, 3), // tl
+	LCD_SEGMENT(8, 4), // tr
+	LCD_SEGMENT(11, 3), // m
+	LCD_SEGMENT(17, 3), // bl
+	LCD_SEGMENT(14, 4), // br
+	LCD_SEGMENT(23, 3), // b
+	LCD_SEGMENT_NONE(),
+
+	// drops
+	LCD_SEGMENT(18, 1), // drop_1
+	LCD_SEGMENT(18, 2), // drop_2
+	LCD_SEGMENT(18, 3), // drop_3
+	LCD_SEGMENT(18, 4), // drop_4
+	LCD_SEGMENT(18, 5), // drop_5
+	LCD_SEGMENT(18, 6), // drop_6
+	LCD_SEGMENT(18, 7), // drop_7
+	LCD_SEGMENT(22, 1), // drop_8
+
+	// drop_stops
+	LCD_SEGMENT(12, 1), // drop_stop_1
+	LCD_SEGMENT(12, 2), // drop_stop_2
+	LCD_SEGMENT(12, 3), // drop_stop_3
+	LCD_SEGMENT(12, 4), // drop_stop_4
+	LCD_SEGMENT(12, 5), // drop_stop_5
+	LCD_SEGMENT(12, 6), // drop_stop_6
+	LCD_SEGMENT(12, 7), // drop_stop_7
+	LCD_SEGMENT(16, 1), // drop_stop_8
+
+	// weekdays
+	LCD_SEGMENT(6, 1), // weekday_mo
+	LCD_SEGMENT(6, 2), // weekday_tu
+	LCD_SEGMENT(6, 3), // weekday_we
+	LCD_SEGMENT(6, 4), // weekday_th
+	LCD_SEGMENT(6, 5), // weekday_fr
+	LCD_SEGMENT(6, 6), // weekday_sa
+	LCD_SEGMENT(6, 7), // weekday_su
+	LCD_SEGMENT_NONE(),
+
+	// bars
+	LCD_SEGMENT(0, 0), // bar_1
+	LCD_SEGMENT(6, 0), // bar_2
+	LCD_SEGMENT(12, 0), // bar_3
+	LCD_SEGMENT(23, 7), // bar_4
+	LCD_SEGMENT(17, 7), // bar_5
+	LCD_SEGMENT(11, 7), // bar_6
+	LCD_SEGMENT(5, 7), // bar_7
+	LCD_SEGMENT(5, 6), // bar_8
+	LCD_SEGMENT(11, 6), // bar_9
+	LCD_SEGMENT(17, 6), // bar_10
+	LCD_SEGMENT(23, 6), // bar_11
+	LCD_SEGMENT(23, 5), // bar_12
+	LCD_SEGMENT(17, 5), // bar_13
+	LCD_SEGMENT(11, 5), // bar_14
+	LCD_SEGMENT(5, 5), // bar_15
+	LCD_SEGMENT_NONE(),
+
+	// calendar_icons
+	LCD_SEGMENT(20, 3), // time_comma
+	LCD_SEGMENT(8, 6), // time_24hr
+	LCD_SEGMENT(2, 5), // time_am
+	LCD_SEGMENT(2, 6), // time_pm
+	LCD_SEGMENT(22, 4), // calendar_month
+	LCD_SEGMENT(20, 4), // calendar_day
+	LCD_SEGMENT(10, 1), // odd
+	LCD_SEGMENT(18, 0), // even
+
+	// other_icons
+	LCD_SEGMENT(20, 5), // cycle
+	LCD_SEGMENT(20, 6), // soak
+	LCD_SEGMENT(23, 2), // umbrella
+	LCD_SEGMENT(14, 6), // spray
+	LCD_SEGMENT(14, 5), // spray_stop
+	LCD_SEGMENT(22, 6), // sand_clock
+	LCD_SEGMENT(22, 2), // alarm_clock
+	LCD_SEGMENT(8, 5), // percent
+};
+
+// LCDDATA bit mask of every display map bit, so the update doesn't shift by the bit number
+static const uint8_t lcd_segments_masks[] =
+{
+	// digit_0
+	0b00010000, // t
+	0b00001000, // tl
+	0b00010000, // tr
+	0b00001000, // m
+	0b00001000, // bl
+	0b00010000, // br
+	0b00001000, // b
+	0b00000000,
+
+	// digit_1
+	0b00000100, // t
+	0b00010000, // tl
+	0b00000100, // tr
+	0b00010000, // m
+	0b00010000, // bl
+	0b00000100, // br
+	0b00010000, // b
+	0b00000000,
+
+	// digit_2
+	0b01000000, // t
+	0b00100000, // tl
+	0b01000000, // tr
+	0b00100000, // m
+	0b00100000, // bl
+	0b01000000, // br
+	0b00100000, // b
+	0b00000000,
+
+	// digit_3
+	0b00001000, // t
+	0b10000000, // tl
+	0b00001000, // tr
+	0b10000000, // m
+	0b10000000, // bl
+	0b00001000, // br
+	0b10000000, // b
+	0b00000000,
+
+	// digit_4
+	0b00000100, // t
+	0b00000001, // tl
+	0b00000100, // tr
+	0b00000001, // m
+	0b00000001, // bl
+	0b00000100, // br
+	0b00000001, // b
+	0b00000000,
+
+	// digit_5
+	0b00010000, // t
+	0b00001000, // tl
+	0b00010000, // tr
+	0b00001000, // m
+	0b00001000, // bl
+	0b00010000, // br
+	0b00001000, // b
+	0b00000000,
+
+	// drops
+	0b00000010, // drop_1
+	0b00000100, // drop_2
+	0b00001000, // drop_3
+	0b00010000, // drop_4
+	0b00100000, // drop_5
+	0b01000000, // drop_6
+	0b10000000, // drop_7
+	0b00000010, // drop_8
+
+	// drop_stops
+	0b00000010, // drop_stop_1
+	0b00000100, // drop_stop_2
+	0b00001000, // drop_stop_3
+	0b00010000, // drop_stop_4
+	0b00100000, // drop_stop_5
+	0b01000000, // drop_stop_6
+	0b10000000, // drop_stop_7
+	0b00000010, // drop_stop_8
+
+	// weekdays
+	0b00000010, // weekday_mo
+	0b00000100, // weekday_tu
+	0b00001000, // weekday_we
+	0b00010000, // weekday_th
+	0b00100000, // weekday_fr
+	0b01000000, // weekday_sa
+	0b10000000, // weekday_su
+	0b00000000,
+
+	// bars
+	0b00000001, // bar_1
+	0b00000001, // bar_2
+	0b00000001, // bar_3
+	0b10000000, // bar_4
+	0b10000000, // bar_5
+	0b10000000, // bar_6
+	0b10000000, // bar_7
+	0b01000000, // bar_8
+	0b01000000, // bar_9
+	0b01000000, // bar_10
+	0b01000000, // bar_11
+	0b00100000, // bar_12
+	0b00100000, // bar_13
+	0b00100000, // bar_14
+	0b00100000, // bar_15
+	0b00000000,
+
+	// calendar_icons
+	0b00001000, // time_comma
+	0b01000000, // time_24hr
+	0b00100000, // time_am
+	0b01000000, // time_pm
+	0b00010000, // calendar_month
+	0b00010000, // calendar_day
+	0b00000010, // odd
+	0b00000001, // even
+
+	// other_icons
+	0b00100000, // cycle
+	0b01000000, // soak
+	0b00000100, // umbrella
+	0b01000000, // spray
+	0b00100000, // spray_stop
+	0b01000000, // sand_clock
+	0b00000100, // alarm_clock
+	0b00100000, // percent
+};
+
+// 7-segment glyphs of characters from LCD_FONT_FIRST to LCD_FONT_LAST, bits in order t, tl, tr, m, bl, br, b
+static const uint8_t lcd_font[] =
+{
+	0b00000000, // ' '
+	0b00000000, // '!'
+	0b00000000, // '"'
+	0b00000000, // '#'
+	0b00000000, // '$'
+	0b00000000, // '%'
+	0b00000000, // '&'
+	0b00000000, // "'"
+	0b00000000, // '('
+	0b00000000, // ')'
+	0b00000000, // '*'
+	0b00000000, // '+'
+	0b00000000, // ','
+	0b00001000, // '-'
+	0b00000000, // '.'
+	0b00000000, // '/'
+	0b01110111, // '0'
+	0b00100100, // '1'
+	0b01011101, // '2'
+	0b01101101, // '3'
+	0b00101110, // '4'
+	0b01101011, // '5'
+	0b01111011, // '6'
+	0b00100101, // '7'
+	0b01111111, // '8'
+	0b01101111, // '9'
+	0b00000000, // ':'
+	0b00000000, // ';'
+	0b00000000, // '<'
+	0b01001000, // '='
+	0b00000000, // '>'
+	0b00011101, // '?'
+	0b00000000, // '@'
+	0b00111111, // 'A'
+	0b01111010, // 'B'
+	0b01010011, // 'C'
+	0b01111100, // 'D'
+	0b01011011, // 'E'
+	0b00011011, // 'F'
+	0b01110011, // 'G'
+	0b00111110, // 'H'
+	0b00010010, // 'I'
+	0b01110100, // 'J'
+	0b00000000, // 'K'
+	0b01010010, // 'L'
+	0b00000000, // 'M'
+	0b00110111, // 'N'
+	0b01110111, // 'O'
+	0b00011111, // 'P'
+	0b00101111, // 'Q'
+	0b00011000, // 'R'
+	0b01101011, // 'S'
+	0b01011010, // 'T'
+	0b01110110, // 'U'
+	0b00000000, // 'V'
+	0b00000000, // 'W'
+	0b00000000, // 'X'
+	0b01101110, // 'Y'
+	0b01011101, // 'Z'
+	0b00000000, // '['
+	0b00000000, // '\\'
+	0b00000000, // ']'
+	0b00000000, // '^'
+	0b01000000, // '_'
+	0b00000000, // '`'
+	0b00111111, // 'a'
+	0b01111010, // 'b'
+	0b01011000, // 'c'
+	0b01111100, // 'd'
+	0b01011011, // 'e'
+	0b00011011, // 'f'
+	0b01110011, // 'g'
+	0b00111010, // 'h'
+	0b00010000, // 'i'
+	0b01110100, // 'j'
+	0b00000000, // 'k'
+	0b01010010, // 'l'
+	0b00000000, // 'm'
+	0b00111000, // 'n'
+	0b01111000, // 'o'
+	0b00011111, // 'p'
+	0b00101111, // 'q'
+	0b00011000, // 'r'
+	0b01101011, // 's'
+	0b01011010, // 't'
+	0b01110000, // 'u'
+	0b00000000, // 'v'
+	0b00000000, // 'w'
+	0b00000000, // 'x'
+	0b01101110, // 'y'
+	0b01011101, // 'z'
+};
\ No newline at end of file
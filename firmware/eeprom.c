@@ -16,39 +16,30 @@
 
 #include "eeprom.h"
 
+// set by the power-fail interrupt to abort writes still to come, the byte being written is finished
+volatile bool eeprom_write_abort = false;
+
 uint8_t eeprom_read_byte(uint16_t offset)
 {
-	EEADRH = offset >> 8;
-	EEADR = offset & 255;
-
-	EECON1bits.EEPGD = 0;
-	EECON1bits.CFGS = 0;
-	EECON1bits.RD = 1;
-	NOP();
-
-	return EEDATA;
+	return hal_eeprom_read(offset);
 }
 
-void eeprom_write_byte(uint16_t offset, uint8_t byte)
+bool eeprom_write_byte(uint16_t offset, uint8_t byte)
 {
-	EEADRH = offset >> 8;
-	EEADR = offset & 255;
-
-	EEDATA = byte;
+	if (eeprom_write_abort)
+		return false;
 
-	EECON1bits.EEPGD = 0;
-	EECON1bits.CFGS = 0;
-	EECON1bits.WREN = 1;
-	bool gie = INTCONbits.GIE;
-
-	EECON2 = 0x55;
-	EECON2 = 0xAA;
+	hal_eeprom_write(offset, byte);
+	return true;
+}
 
-	EECON1bits.WR = 1;
-	while(EECON1bits.WR);
+bool eeprom_update_byte(uint16_t offset, uint8_t byte)
+{
+	// write only if the value differs, it saves both the time and the cell endurance
+	if (eeprom_read_byte(offset) == byte)
+		return true;
 
-	INTCONbits.GIE = gie;
-	EECON1bits.WREN = 0;
+	return eeprom_write_byte(offset, byte);
 }
 
 void eeprom_read_data(uint8_t* ptr, uint16_t size, uint16_t offset)
@@ -57,17 +48,29 @@ void eeprom_read_data(uint8_t* ptr, uint16_t size, uint16_t offset)
 		ptr[n] = eeprom_read_byte(offset + n);
 }
 
-void eeprom_write_data(const uint8_t* ptr, uint16_t size, uint16_t offset)
+bool eeprom_write_data(const uint8_t* ptr, uint16_t size, uint16_t offset)
 {
 	for (uint16_t n = 0; n < size; ++n)
-		eeprom_write_byte(offset + n, ptr[n]);
+		if (!eeprom_write_byte(offset + n, ptr[n]))
+			return false;
+
+	return true;
+}
+
+bool eeprom_update_data(const uint8_t* ptr, uint16_t size, uint16_t offset)
+{
+	for (uint16_t n = 0; n < size; ++n)
+		if (!eeprom_update_byte(offset + n, ptr[n]))
+			return false;
+
+	return true;
 }
 
 void eeprom_validate(void)
 {
-	eeprom_write_byte(0x3FF, 0xAA);
+	eeprom_write_byte(0x3FF, EEPROM_LAYOUT);
 }
-bool eeprom_check(void)
+bool eeprom_check(uint8_t layout)
 {
-	return (eeprom_read_byte(0x3FF) == 0xAA);
+	return (eeprom_read_byte(0x3FF) == layout);
 }
\ No newline at end of file
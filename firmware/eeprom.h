@@ -18,10 +18,21 @@
 
 #include "types.h"
 
+// layout marker stored in the last EEPROM byte
+#define EEPROM_LAYOUT			0xAC
+// interval program offsets counted from the year day instead of the epoch day
+#define EEPROM_LAYOUT_YEAR_DAY	0xAB
+// single programs image without sequence and checksum (and year day offsets)
+#define EEPROM_LAYOUT_LEGACY	0xAA
+
+extern volatile bool eeprom_write_abort;
+
 uint8_t eeprom_read_byte(uint16_t offset);
-void eeprom_write_byte(uint16_t offset, uint8_t byte);
+bool eeprom_write_byte(uint16_t offset, uint8_t byte);
+bool eeprom_update_byte(uint16_t offset, uint8_t byte);
 void eeprom_read_data(uint8_t* ptr, uint16_t size, uint16_t offset);
-void eeprom_write_data(const uint8_t* ptr, uint16_t size, uint16_t offset);
+bool eeprom_write_data(const uint8_t* ptr, uint16_t size, uint16_t offset);
+bool eeprom_update_data(const uint8_t* ptr, uint16_t size, uint16_t offset);
 
 void eeprom_validate(void);
-bool eeprom_check(void);
\ No newline at end of file
+bool eeprom_check(uint8_t layout);
\ No newline at end of file
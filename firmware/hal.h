@@ -0,0 +1,63 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// hardware abstraction of the peripherals that can't be used just by their registers,
+// trivial parts are mapped directly to the registers, the rest is implemented in hal_pic.c
+// the host build (host/) emulates all of it and keeps other registers as plain memory
+
+#ifdef HOST
+
+#include "host/hal_host.h"
+
+#else
+
+#include <xc.h>
+
+// LCDDATA0-LCDDATA23
+#define HAL_LCD_DATA ((volatile uint8_t*)0xF66)
+
+#define hal_delay_ms(ms) __delay_ms(ms)
+
+// SLEEP instruction, OSCCONbits.IDLEN selects idle or sleep mode, it returns after a wake-up
+#define hal_sleep() do { SLEEP(); NOP(); } while (0)
+#define hal_reset() RESET()
+
+#define hal_hlvd_stable() (HLVDCONbits.IRVST)
+
+// remote interface, PGC is the clock from the remote, PGD the data line in both directions
+#define hal_remote_clock() (PORTBbits.PGC)
+#define hal_remote_data() (PORTBbits.PGD)
+#define hal_remote_set_data(level) (PORTBbits.PGD = (level))
+#define hal_remote_data_output(output) (TRISBbits.TRISB7 = !(output))
+
+#endif
+
+uint8_t hal_eeprom_read(uint16_t offset);
+void hal_eeprom_write(uint16_t offset, uint8_t byte);
+
+// RTCC values are BCD in order of RTCVAL registers: year, (reserved), day, month, hours, weekday, seconds, minutes
+#define HAL_RTCC_VALUES 8
+void hal_rtcc_read(uint8_t* values);
+void hal_rtcc_write(const uint8_t* values, bool keep_seconds);
+void hal_rtcc_wait_second(void);
+
+// wait for PGC flips to state, timeout is given in timer0 ticks (1us << (prescaler + 1) at 4MHz)
+bool hal_remote_wait_clock(uint8_t prescaler, uint8_t ticks, bool state);
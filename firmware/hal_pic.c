@@ -0,0 +1,93 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "hal.h"
+
+uint8_t hal_eeprom_read(uint16_t offset)
+{
+	EEADRH = offset >> 8;
+	EEADR = offset & 255;
+
+	EECON1bits.EEPGD = 0;
+	EECON1bits.CFGS = 0;
+	EECON1bits.RD = 1;
+	NOP();
+
+	return EEDATA;
+}
+
+void hal_eeprom_write(uint16_t offset, uint8_t byte)
+{
+	EEADRH = offset >> 8;
+	EEADR = offset & 255;
+
+	EEDATA = byte;
+
+	EECON1bits.EEPGD = 0;
+	EECON1bits.CFGS = 0;
+	EECON1bits.WREN = 1;
+	bool gie = INTCONbits.GIE;
+	INTCONbits.GIE = 0;
+
+	EECON2 = 0x55;
+	EECON2 = 0xAA;
+
+	EECON1bits.WR = 1;
+	while(EECON1bits.WR);
+
+	INTCONbits.GIE = gie;
+	EECON1bits.WREN = 0;
+}
+
+void hal_rtcc_read(uint8_t* values)
+{
+	// pointer decrements on every RTCVALH read
+	RTCCFGbits.RTCPTR = 3;
+	while (RTCCFGbits.RTCSYNC);
+	for (uint8_t n = 0; n < HAL_RTCC_VALUES; n += 2)
+	{
+		values[n] = RTCVALL;
+		values[n + 1] = RTCVALH;
+	}
+}
+
+void hal_rtcc_write(const uint8_t* values, bool keep_seconds)
+{
+	// RTCC writes must be enabled, pointer decrements on every RTCVALH write
+	RTCCFGbits.RTCPTR = 3;
+	while (RTCCFGbits.RTCSYNC);
+	for (uint8_t n = 0; n < HAL_RTCC_VALUES; n += 2)
+	{
+		if (n != 6 || !keep_seconds)
+			RTCVALL = values[n];
+		RTCVALH = values[n + 1];
+	}
+}
+
+void hal_rtcc_wait_second(void)
+{
+	while (!RTCCFGbits.HALFSEC);
+	while (RTCCFGbits.HALFSEC);
+}
+
+bool hal_remote_wait_clock(uint8_t prescaler, uint8_t ticks, bool state)
+{
+	T0CON = 0b11000000 + prescaler;
+	TMR0L = 255 - ticks + 1;
+	INTCONbits.T0IF = 0;
+	while (!INTCONbits.T0IF && PORTBbits.PGC != state);
+	return !INTCONbits.T0IF;
+}
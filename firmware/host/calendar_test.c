@@ -0,0 +1,96 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Calendar check, compares the firmware calendar with the C library for every day of 2000-2099
+
+#define _DEFAULT_SOURCE
+
+#include "../calendar.h"
+
+#include <stdio.h>
+#include <time.h>
+
+// 2000-01-01 in UNIX time
+#define EPOCH 946684800
+
+// interval program migrated on this day has to water on the same days as before until the end of month,
+// offset the older firmware stored is checked for every interval length
+static unsigned check_migration(uint8_t year, uint8_t month, uint8_t day)
+{
+	unsigned errors = 0;
+
+	for (uint8_t days = 0; days < 8; ++days)
+	{
+		for (uint8_t offset = 0; offset <= days; ++offset)
+		{
+			uint8_t migrated = calendar_migrate_offset(offset, days, year, month, day);
+			for (uint8_t n = day; n <= calendar_month_days(year, month); ++n)
+			{
+				bool legacy_run = (calendar_legacy_year_day(year, month, n) % (days + 1) == offset);
+				bool run = (calendar_epoch_day(year, month, n) % (days + 1) == migrated);
+				if (legacy_run != run && errors++ < 10)
+					printf("20%02u-%02u-%02u: %u-day interval offset %u migrated to %u, day %u %s\n",
+						year, month, day, days + 1, offset, migrated, n, run ? "waters" : "doesn't water");
+			}
+		}
+	}
+
+	return errors;
+}
+
+int main(void)
+{
+	unsigned errors = 0;
+	unsigned days = 0;
+
+	for (time_t time = EPOCH; ; time += 86400, ++days)
+	{
+		struct tm tm;
+		gmtime_r(&time, &tm);
+		if (tm.tm_year >= 200)
+			break;
+
+		uint8_t year = (uint8_t)(tm.tm_year - 100);
+		uint8_t month = (uint8_t)(tm.tm_mon + 1);
+		uint8_t day = (uint8_t)tm.tm_mday;
+
+		// weekday of the C library starts by Sunday, firmware one by Monday
+		uint16_t epoch_day = calendar_epoch_day(year, month, day);
+		uint8_t weekday = calendar_weekday(epoch_day);
+		uint16_t year_day = calendar_year_day(year, month, day);
+		if (epoch_day != days || weekday != (tm.tm_wday + 6) % 7 || year_day != tm.tm_yday)
+		{
+			if (errors++ < 10)
+				printf("20%02u-%02u-%02u: epoch day %u, weekday %u, year day %u, expected %u, %u, %u\n",
+					year, month, day, epoch_day, weekday, year_day, days, (tm.tm_wday + 6) % 7, tm.tm_yday);
+		}
+
+		// the last day of month tells the month length
+		struct tm next;
+		time_t tomorrow = time + 86400;
+		gmtime_r(&tomorrow, &next);
+		if (next.tm_mday == 1 && calendar_month_days(year, month) != day)
+		{
+			if (errors++ < 10)
+				printf("20%02u-%02u: %u days, expected %u\n", year, month, calendar_month_days(year, month), day);
+		}
+
+		errors += check_migration(year, month, day);
+	}
+
+	printf("calendar checked %u days, %u errors\n", days, errors);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _DEFAULT_SOURCE
+#define HOST_SFR_DEFINE
+
+#include "../hal.h"
+
+#include <setjmp.h>
+#include <time.h>
+
+// timer1 frame, RTCC alarm, timer4 controls scan and mains periods in us
+#define FRAME_PERIOD		125000ULL
+#define MINUTE_PERIOD		60000000ULL
+#define CONTROLS_PERIOD		8000ULL
+#define AC_PERIOD			20000ULL
+
+// timer5 runs from Fosc/4 with 1:8 pre-scaler
+#define TIMER5_TICK			8
+
+// timer6 runs from Fosc/4 with 1:16 pre-scaler and 1:16 post-scaler
+#define TIMER6_TICK			256
+
+// 2000-01-01 in UNIX time
+#define RTCC_EPOCH			946684800
+
+void isr(void);
+
+volatile uint8_t host_lcd_data[24];
+
+host_environment_t host_environment = { .ac = true, .ac_decimation = 1, .frame_decimation = 1, .controls = true, .selection = 0, .remote_clock = false, .remote_data = false };
+uint64_t host_time = 0;
+uint8_t host_eeprom[1024] = { [0 ... 1023] = 0xFF };
+uint32_t host_eeprom_writes[1024];
+void (*host_hook)(void) = 0;
+host_peer_t* host_peer = 0;
+
+// RTCC time in us since 2000-01-01
+static uint64_t rtcc_time = 0;
+
+// end of the running timer6 period, 0 when it's stopped
+static uint64_t timer6_end = 0;
+
+static bool remote_data = false;
+static bool remote_data_output = false;
+
+static jmp_buf run_exit;
+static uint64_t run_end = 0;
+static bool run_reset = false;
+
+static uint64_t next_period(uint64_t time, uint64_t period)
+{
+	return time - time % period + period;
+}
+
+static void step(uint64_t elapsed)
+{
+	host_time += elapsed;
+	rtcc_time += elapsed;
+
+	// decimated mains keeps timer5 still, every edge sets it forward by the nominal period
+	if (T5CONbits.TMR5ON && !(host_environment.ac && host_environment.ac_decimation > 1))
+	{
+		uint32_t timer = (((uint32_t)TMR5H << 8) | TMR5L) + (uint32_t)(elapsed / TIMER5_TICK);
+		if (timer > 0xFFFF)
+			PIR5bits.TMR5IF = 1;
+		TMR5H = (timer >> 8) & 255;
+		TMR5L = timer & 255;
+	}
+
+	if (host_time >= run_end)
+		longjmp(run_exit, 1);
+}
+
+// runs the peer device, returns true if it raised the interrupt-on-change
+static bool peer_run(void)
+{
+	bool clock = host_environment.remote_clock;
+	host_peer->run();
+
+	if (clock == host_environment.remote_clock || !IOCBbits.IOCB6 || !INTCONbits.RBIE)
+		return false;
+
+	INTCONbits.RBIF = 1;
+	return true;
+}
+
+// emulates the peripherals until the given time, interrupts are served as they come (or regardless of GIE when woken up)
+static void advance(uint64_t until, bool wake)
+{
+	for (;;)
+	{
+		if (host_peer && host_peer->wake_time <= host_time)
+		{
+			if (!peer_run())
+				continue;
+
+			if (wake || INTCONbits.GIE)
+			{
+				isr();
+				if (host_hook)
+					host_hook();
+			}
+
+			if (wake)
+				return;
+			continue;
+		}
+
+		bool frame = (T1CON & 1) && PIE1bits.TMR1IE;
+		uint64_t frame_period = FRAME_PERIOD * (host_environment.frame_decimation ? host_environment.frame_decimation : 1);
+		bool alarm = ALRMCFGbits.ALRMEN && PIE3bits.RTCCIE;
+		bool controls = (T4CON & 0b100) && PIE5bits.TMR4IE && host_environment.controls;
+		bool ac = host_environment.ac && INTCONbits.INT0IE;
+		uint64_t ac_period = AC_PERIOD * (host_environment.ac_decimation ? host_environment.ac_decimation : 1);
+		bool timeout = T5CONbits.TMR5ON && PIE5bits.TMR5IE;
+
+		// timer6 period starts when the firmware enables it
+		bool sensor = (T6CON & 0b100) && PIE5bits.TMR6IE;
+		if (!sensor)
+			timer6_end = 0;
+		else if (timer6_end == 0)
+			timer6_end = host_time + (PR6 + 1) * TIMER6_TICK;
+
+		uint64_t elapsed = (until > host_time) ? until - host_time : 0;
+		if (frame && next_period(rtcc_time, frame_period) - rtcc_time < elapsed)
+			elapsed = next_period(rtcc_time, frame_period) - rtcc_time;
+		if (alarm && next_period(rtcc_time, MINUTE_PERIOD) - rtcc_time < elapsed)
+			elapsed = next_period(rtcc_time, MINUTE_PERIOD) - rtcc_time;
+		if (controls && next_period(host_time, CONTROLS_PERIOD) - host_time < elapsed)
+			elapsed = next_period(host_time, CONTROLS_PERIOD) - host_time;
+		if (ac && next_period(host_time, ac_period) - host_time < elapsed)
+			elapsed = next_period(host_time, ac_period) - host_time;
+		if (timeout && !(host_environment.ac && host_environment.ac_decimation > 1))
+		{
+			uint64_t overflow = (0x10000 - (((uint32_t)TMR5H << 8) | TMR5L)) * TIMER5_TICK;
+			if (overflow < elapsed)
+				elapsed = overflow;
+		}
+		if (sensor && timer6_end - host_time < elapsed)
+			elapsed = timer6_end - host_time;
+		if (host_peer && host_peer->wake_time - host_time < elapsed)
+			elapsed = host_peer->wake_time - host_time;
+
+		if (elapsed == 0)
+			return;
+
+		// when nothing can wake the core, it sleeps till the end of the run
+		if (elapsed > run_end - host_time)
+			elapsed = run_end - host_time;
+
+		step(elapsed);
+
+		bool interrupt = PIR5bits.TMR5IF && timeout;
+		if (frame && rtcc_time % frame_period == 0)
+		{
+			// decimated frames are ticked at once at the end of the batch, the main loop sees them all elapsed,
+			// the hook is called after the last one only, the time doesn't move meanwhile
+			for (uint8_t n = 1; n < frame_period / FRAME_PERIOD && (wake || INTCONbits.GIE); ++n)
+			{
+				PIR1bits.TMR1IF = 1;
+				isr();
+			}
+			PIR1bits.TMR1IF = 1, interrupt = true;
+		}
+		if (alarm && rtcc_time % MINUTE_PERIOD == 0)
+			PIR3bits.RTCCIF = 1, interrupt = true;
+		if (controls && host_time % CONTROLS_PERIOD == 0)
+			PIR5bits.TMR4IF = 1, interrupt = true;
+		if (sensor && host_time >= timer6_end)
+		{
+			PIR5bits.TMR6IF = 1, interrupt = true;
+			timer6_end += (PR6 + 1) * TIMER6_TICK;
+		}
+		if (ac && host_time % ac_period == 0)
+		{
+			INTCONbits.INT0IF = 1, interrupt = true;
+
+			if (host_environment.ac_decimation > 1)
+			{
+				uint16_t timer = (uint16_t)((((uint16_t)TMR5H << 8) | TMR5L) + AC_PERIOD / TIMER5_TICK);
+				TMR5H = timer >> 8;
+				TMR5L = timer & 255;
+			}
+		}
+
+		if (!interrupt)
+			continue;
+
+		if (wake || INTCONbits.GIE)
+		{
+			isr();
+			if (host_hook)
+				host_hook();
+		}
+
+		if (wake)
+			return;
+	}
+}
+
+static uint8_t to_bcd(int number)
+{
+	return (uint8_t)(((number / 10) << 4) | (number % 10));
+}
+static int from_bcd(uint8_t bcd)
+{
+	return (bcd >> 4) * 10 + (bcd & 15);
+}
+
+uint8_t host_port_e(void)
+{
+	// contacts of the driven row pull the column down, pull-ups keep the rest high
+	uint8_t row = !PORTBbits.RB3 ? 0 : !PORTBbits.RB2 ? 1 : !PORTBbits.RB1 ? 2 : 3;
+	static const uint8_t columns[3] = { 0b110, 0b101, 0b011 };
+	if (row == host_environment.selection / 3)
+		return columns[host_environment.selection % 3];
+	return 0b111;
+}
+
+void hal_delay_ms(uint16_t ms)
+{
+	advance(host_time + ms * 1000ULL, false);
+}
+
+void hal_sleep(void)
+{
+	advance(UINT64_MAX, true);
+}
+
+void hal_reset(void)
+{
+	run_reset = true;
+	longjmp(run_exit, 1);
+}
+
+bool hal_hlvd_stable(void)
+{
+	return true;
+}
+
+bool hal_remote_clock(void)
+{
+	return host_environment.remote_clock;
+}
+bool hal_remote_data(void)
+{
+	return remote_data_output ? remote_data : host_environment.remote_data;
+}
+void hal_remote_set_data(bool level)
+{
+	remote_data = level;
+	if (host_peer)
+		host_peer->remote_data_changed(remote_data_output, remote_data);
+}
+void hal_remote_data_output(bool output)
+{
+	remote_data_output = output;
+	if (host_peer)
+		host_peer->remote_data_changed(remote_data_output, remote_data);
+}
+
+bool hal_remote_wait_clock(uint8_t prescaler, uint8_t ticks, bool state)
+{
+	// timer0 is polled in a loop, PGC change is seen within a microsecond
+	uint64_t timeout = host_time + ((uint64_t)ticks << (prescaler + 1));
+	while (host_environment.remote_clock != state)
+	{
+		if (host_time >= timeout)
+			return false;
+		advance(host_time + 1, false);
+	}
+	return true;
+}
+
+uint8_t hal_eeprom_read(uint16_t offset)
+{
+	return host_eeprom[offset & 1023];
+}
+
+void hal_eeprom_write(uint16_t offset, uint8_t byte)
+{
+	host_eeprom[offset & 1023] = byte;
+	host_eeprom_writes[offset & 1023]++;
+}
+
+void hal_rtcc_read(uint8_t* values)
+{
+	time_t time = (time_t)(rtcc_time / 1000000) + RTCC_EPOCH;
+	struct tm tm;
+	gmtime_r(&time, &tm);
+
+	values[0] = to_bcd(tm.tm_year - 100);
+	values[1] = 0;
+	values[2] = to_bcd(tm.tm_mday);
+	values[3] = to_bcd(tm.tm_mon + 1);
+	values[4] = to_bcd(tm.tm_hour);
+	values[5] = (uint8_t)((tm.tm_wday + 6) % 7);
+	values[6] = to_bcd(tm.tm_sec);
+	values[7] = to_bcd(tm.tm_min);
+}
+
+void hal_rtcc_write(const uint8_t* values, bool keep_seconds)
+{
+	struct tm tm = {};
+	tm.tm_year = from_bcd(values[0]) + 100;
+	tm.tm_mday = from_bcd(values[2]);
+	tm.tm_mon = from_bcd(values[3]) - 1;
+	tm.tm_hour = from_bcd(values[4]);
+	tm.tm_min = from_bcd(values[7]);
+	tm.tm_sec = from_bcd(values[6]);
+
+	// writing the seconds restarts the second, otherwise its phase is kept
+	uint64_t phase = 0;
+	if (keep_seconds)
+	{
+		tm.tm_sec = 0;
+		phase = rtcc_time % MINUTE_PERIOD;
+	}
+
+	rtcc_time = (uint64_t)(timegm(&tm) - RTCC_EPOCH) * 1000000 + phase;
+}
+
+void hal_rtcc_wait_second(void)
+{
+	advance(host_time + 1000000 - rtcc_time % 1000000, false);
+}
+
+void host_rtcc_set(uint32_t seconds)
+{
+	rtcc_time = (uint64_t)seconds * 1000000;
+	RTCCFGbits.RTCEN = 1;
+}
+uint32_t host_rtcc_get(void)
+{
+	return (uint32_t)(rtcc_time / 1000000);
+}
+
+bool host_run(void (*entry)(void), uint64_t duration)
+{
+	// state of the status bits the firmware waits for
+	OSCCONbits.OSTS = 1;
+	LCDPSbits.WA = 1;
+
+	run_end = host_time + duration;
+	run_reset = false;
+	if (!setjmp(run_exit))
+		entry();
+
+	return !run_reset;
+}
+
+void host_stop(void)
+{
+	longjmp(run_exit, 1);
+}
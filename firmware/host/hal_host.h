@@ -0,0 +1,286 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// host (x86 Linux) implementation of the hardware abstraction, registers are plain memory
+// and the peripherals needed to run the firmware (timers, RTCC, EEPROM, LCD, mains sense) are emulated
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define NOP() ((void)0)
+#define CLRWDT() ((void)0)
+
+#define __interrupt()
+
+#ifdef HOST_SFR_DEFINE
+#define HOST_SFR_STORAGE
+#else
+#define HOST_SFR_STORAGE extern
+#endif
+
+#define HOST_SFR(name) HOST_SFR_STORAGE volatile uint8_t name
+#define HOST_SFR_BITS(name, ...) typedef union { uint8_t value; struct { __VA_ARGS__ }; } host_##name##_t; HOST_SFR_STORAGE volatile host_##name##_t host_##name
+
+// registers written and read as a whole only
+HOST_SFR(ADCON0);
+HOST_SFR(ADCON1);
+HOST_SFR(ALRMVALH);
+HOST_SFR(ALRMVALL);
+HOST_SFR(ANCON0);
+HOST_SFR(ANCON1);
+HOST_SFR(ANCON2);
+HOST_SFR(CCPR3L);
+HOST_SFR(CCPTMRS0);
+HOST_SFR(CM1CON);
+HOST_SFR(CM2CON);
+HOST_SFR(CM3CON);
+HOST_SFR(CTMUCONH);
+HOST_SFR(CTMUICON);
+HOST_SFR(CVRCON);
+HOST_SFR(ECCP3AS);
+HOST_SFR(ECCP3DEL);
+HOST_SFR(EECON2);
+HOST_SFR(LATA);
+HOST_SFR(LATC);
+HOST_SFR(LATD);
+HOST_SFR(LATE);
+HOST_SFR(LATF);
+HOST_SFR(LATG);
+HOST_SFR(LATH);
+HOST_SFR(LATJ);
+HOST_SFR(LCDCON);
+HOST_SFR(LCDRL);
+HOST_SFR(LCDSE0);
+HOST_SFR(LCDSE1);
+HOST_SFR(LCDSE2);
+HOST_SFR(LCDSE3);
+HOST_SFR(LCDSE4);
+HOST_SFR(LCDSE5);
+HOST_SFR(ODCON1);
+HOST_SFR(ODCON2);
+HOST_SFR(ODCON3);
+HOST_SFR(PIE4);
+HOST_SFR(PIR4);
+HOST_SFR(PMD1);
+HOST_SFR(PORTD);
+HOST_SFR(PORTF);
+HOST_SFR(PORTH);
+HOST_SFR(PR2);
+HOST_SFR(PR4);
+HOST_SFR(PR6);
+HOST_SFR(PSTR1CON);
+HOST_SFR(PSTR2CON);
+HOST_SFR(PSTR3CON);
+HOST_SFR(REFOCON);
+HOST_SFR(RTCCAL);
+HOST_SFR(T0CON);
+HOST_SFR(T1CON);
+HOST_SFR(T1GCON);
+HOST_SFR(T2CON);
+HOST_SFR(T3CON);
+HOST_SFR(T3GCON);
+HOST_SFR(T4CON);
+HOST_SFR(T5GCON);
+HOST_SFR(T6CON);
+HOST_SFR(TMR0L);
+HOST_SFR(TMR1H);
+HOST_SFR(TMR1L);
+HOST_SFR(TMR3H);
+HOST_SFR(TMR3L);
+HOST_SFR(TMR4);
+HOST_SFR(TMR5H);
+HOST_SFR(TMR5L);
+HOST_SFR(TMR6);
+HOST_SFR(TRISC);
+HOST_SFR(TRISD);
+HOST_SFR(TRISE);
+HOST_SFR(TRISF);
+HOST_SFR(TRISH);
+HOST_SFR(WDTCON);
+
+// registers accessed by bits too, bit positions follow the datasheet
+HOST_SFR_BITS(ALRMCFG, unsigned ALRMPTR:2; unsigned AMASK:4; unsigned CHIME:1; unsigned ALRMEN:1;);
+HOST_SFR_BITS(CCP3CON, unsigned CCP3M:4; unsigned DC3B:2; unsigned P3M:2;);
+HOST_SFR_BITS(HLVDCON, unsigned HLVDL:4; unsigned HLVDEN:1; unsigned IRVST:1; unsigned BGVST:1; unsigned VDIRMAG:1;);
+HOST_SFR_BITS(INTCON, unsigned RBIF:1; unsigned INT0IF:1; unsigned T0IF:1; unsigned RBIE:1; unsigned INT0IE:1; unsigned T0IE:1; unsigned PEIE:1; unsigned GIE:1;);
+HOST_SFR_BITS(INTCON2, unsigned RBIP:1; unsigned INT3IP:1; unsigned TMR0IP:1; unsigned INTEDG3:1; unsigned INTEDG2:1; unsigned INTEDG1:1; unsigned INTEDG0:1; unsigned RBPU:1;);
+HOST_SFR_BITS(INTCON3, unsigned INT1IF:1; unsigned INT2IF:1; unsigned INT3IF:1; unsigned INT1IE:1; unsigned INT2IE:1; unsigned INT3IE:1; unsigned INT1IP:1; unsigned INT2IP:1;);
+HOST_SFR_BITS(IOCB, unsigned :4; unsigned IOCB4:1; unsigned IOCB5:1; unsigned IOCB6:1; unsigned IOCB7:1;);
+HOST_SFR_BITS(LATB, unsigned LATB0:1; unsigned LATB1:1; unsigned LATB2:1; unsigned LATB3:1; unsigned LATB4:1; unsigned LATB5:1; unsigned LATB6:1; unsigned LATB7:1;);
+HOST_SFR_BITS(LCDPS, unsigned LP:4; unsigned WA:1; unsigned LCDA:1; unsigned BIASMD:1; unsigned WFT:1;);
+HOST_SFR_BITS(LCDREF, unsigned VLCD1PE:1; unsigned VLCD2PE:1; unsigned VLCD3PE:1; unsigned LCDCST:3; unsigned LCDIRS:1; unsigned LCDIRE:1;);
+HOST_SFR_BITS(OSCCON, unsigned SCS:2; unsigned HFIOFS:1; unsigned OSTS:1; unsigned IRCF:3; unsigned IDLEN:1;);
+HOST_SFR_BITS(OSCCON2, unsigned MFIOSEL:1; unsigned MFIOFS:1; unsigned PRISD:1; unsigned SOSCGO:1; unsigned SOSCDRV:1; unsigned :1; unsigned SOSCRUN:1; unsigned :1;);
+HOST_SFR_BITS(PADCFG1, unsigned :1; unsigned RTSECSEL:2; unsigned :2; unsigned RJPU:1; unsigned REPU:1; unsigned RDPU:1;);
+HOST_SFR_BITS(PIE1, unsigned TMR1IE:1; unsigned TMR2IE:1; unsigned :6;);
+HOST_SFR_BITS(PIE2, unsigned :2; unsigned HLVDIE:1; unsigned :5;);
+HOST_SFR_BITS(PIE3, unsigned RTCCIE:1; unsigned :7;);
+HOST_SFR_BITS(PIE5, unsigned TMR3GIE:1; unsigned TMR4IE:1; unsigned TMR5IE:1; unsigned TMR6IE:1; unsigned :4;);
+HOST_SFR_BITS(PIE6, unsigned CMP1IE:1; unsigned CMP2IE:1; unsigned CMP3IE:1; unsigned :1; unsigned EEIE:1; unsigned :3;);
+HOST_SFR_BITS(PIR1, unsigned TMR1IF:1; unsigned TMR2IF:1; unsigned :6;);
+HOST_SFR_BITS(PIR2, unsigned :2; unsigned HLVDIF:1; unsigned :5;);
+HOST_SFR_BITS(PIR3, unsigned RTCCIF:1; unsigned :7;);
+HOST_SFR_BITS(PIR5, unsigned TMR3GIF:1; unsigned TMR4IF:1; unsigned TMR5IF:1; unsigned TMR6IF:1; unsigned :4;);
+HOST_SFR_BITS(PIR6, unsigned CMP1IF:1; unsigned CMP2IF:1; unsigned CMP3IF:1; unsigned :1; unsigned EEIF:1; unsigned :3;);
+HOST_SFR_BITS(PORTA, unsigned RA0:1; unsigned RA1:1; unsigned RA2:1; unsigned RA3:1; unsigned RA4:1; unsigned RA5:1; unsigned RA6:1; unsigned RA7:1;);
+HOST_SFR_BITS(PORTB, unsigned RB0:1; unsigned RB1:1; unsigned RB2:1; unsigned RB3:1; unsigned RB4:1; unsigned RB5:1; unsigned RB6:1; unsigned RB7:1;);
+HOST_SFR_BITS(PORTC, unsigned RC0:1; unsigned RC1:1; unsigned RC2:1; unsigned RC3:1; unsigned RC4:1; unsigned RC5:1; unsigned RC6:1; unsigned RC7:1;);
+HOST_SFR_BITS(PORTG, unsigned RG0:1; unsigned RG1:1; unsigned RG2:1; unsigned RG3:1; unsigned RG4:1; unsigned RG5:1; unsigned RG6:1; unsigned RG7:1;);
+HOST_SFR_BITS(PORTJ, unsigned RJ0:1; unsigned RJ1:1; unsigned RJ2:1; unsigned RJ3:1; unsigned RJ4:1; unsigned RJ5:1; unsigned RJ6:1; unsigned RJ7:1;);
+HOST_SFR_BITS(RCON, unsigned BOR:1; unsigned POR:1; unsigned PD:1; unsigned TO:1; unsigned RI:1; unsigned CM:1; unsigned SBOREN:1; unsigned IPEN:1;);
+HOST_SFR_BITS(RTCCFG, unsigned RTCPTR:2; unsigned RTCOE:1; unsigned HALFSEC:1; unsigned RTCSYNC:1; unsigned RTCWREN:1; unsigned :1; unsigned RTCEN:1;);
+HOST_SFR_BITS(T5CON, unsigned TMR5ON:1; unsigned RD16:1; unsigned T5SYNC:1; unsigned SOSCEN:1; unsigned T5CKPS:2; unsigned TMR5CS:2;);
+HOST_SFR_BITS(TRISA, unsigned TRISA0:1; unsigned TRISA1:1; unsigned TRISA2:1; unsigned TRISA3:1; unsigned TRISA4:1; unsigned TRISA5:1; unsigned TRISA6:1; unsigned TRISA7:1;);
+HOST_SFR_BITS(TRISB, unsigned TRISB0:1; unsigned TRISB1:1; unsigned TRISB2:1; unsigned TRISB3:1; unsigned TRISB4:1; unsigned TRISB5:1; unsigned TRISB6:1; unsigned TRISB7:1;);
+HOST_SFR_BITS(TRISG, unsigned TRISG0:1; unsigned TRISG1:1; unsigned TRISG2:1; unsigned TRISG3:1; unsigned TRISG4:1; unsigned TRISG5:1; unsigned TRISG6:1; unsigned TRISG7:1;);
+HOST_SFR_BITS(TRISJ, unsigned TRISJ0:1; unsigned TRISJ1:1; unsigned TRISJ2:1; unsigned TRISJ3:1; unsigned TRISJ4:1; unsigned TRISJ5:1; unsigned TRISJ6:1; unsigned TRISJ7:1;);
+
+#define ALRMCFG host_ALRMCFG.value
+#define ALRMCFGbits host_ALRMCFG
+#define CCP3CON host_CCP3CON.value
+#define CCP3CONbits host_CCP3CON
+#define HLVDCON host_HLVDCON.value
+#define HLVDCONbits host_HLVDCON
+#define INTCON host_INTCON.value
+#define INTCONbits host_INTCON
+#define INTCON2 host_INTCON2.value
+#define INTCON2bits host_INTCON2
+#define INTCON3 host_INTCON3.value
+#define INTCON3bits host_INTCON3
+#define IOCB host_IOCB.value
+#define IOCBbits host_IOCB
+#define LATB host_LATB.value
+#define LATBbits host_LATB
+#define LCDPS host_LCDPS.value
+#define LCDPSbits host_LCDPS
+#define LCDREF host_LCDREF.value
+#define LCDREFbits host_LCDREF
+#define OSCCON host_OSCCON.value
+#define OSCCONbits host_OSCCON
+#define OSCCON2 host_OSCCON2.value
+#define OSCCON2bits host_OSCCON2
+#define PADCFG1 host_PADCFG1.value
+#define PADCFG1bits host_PADCFG1
+#define PIE1 host_PIE1.value
+#define PIE1bits host_PIE1
+#define PIE2 host_PIE2.value
+#define PIE2bits host_PIE2
+#define PIE3 host_PIE3.value
+#define PIE3bits host_PIE3
+#define PIE5 host_PIE5.value
+#define PIE5bits host_PIE5
+#define PIE6 host_PIE6.value
+#define PIE6bits host_PIE6
+#define PIR1 host_PIR1.value
+#define PIR1bits host_PIR1
+#define PIR2 host_PIR2.value
+#define PIR2bits host_PIR2
+#define PIR3 host_PIR3.value
+#define PIR3bits host_PIR3
+#define PIR5 host_PIR5.value
+#define PIR5bits host_PIR5
+#define PIR6 host_PIR6.value
+#define PIR6bits host_PIR6
+#define PORTA host_PORTA.value
+#define PORTAbits host_PORTA
+#define PORTB host_PORTB.value
+#define PORTBbits host_PORTB
+#define PORTC host_PORTC.value
+#define PORTCbits host_PORTC
+#define PORTG host_PORTG.value
+#define PORTGbits host_PORTG
+#define PORTJ host_PORTJ.value
+#define PORTJbits host_PORTJ
+#define RCON host_RCON.value
+#define RCONbits host_RCON
+#define RTCCFG host_RTCCFG.value
+#define RTCCFGbits host_RTCCFG
+#define T5CON host_T5CON.value
+#define T5CONbits host_T5CON
+#define TRISA host_TRISA.value
+#define TRISAbits host_TRISA
+#define TRISB host_TRISB.value
+#define TRISBbits host_TRISB
+#define TRISG host_TRISG.value
+#define TRISGbits host_TRISG
+#define TRISJ host_TRISJ.value
+#define TRISJbits host_TRISJ
+
+// rotary controller contacts read through the rows driven by RB1-RB3
+#define PORTE host_port_e()
+uint8_t host_port_e(void);
+
+// LCDDATA0-LCDDATA23
+extern volatile uint8_t host_lcd_data[24];
+#define HAL_LCD_DATA host_lcd_data
+
+void hal_delay_ms(uint16_t ms);
+void hal_sleep(void);
+void hal_reset(void);
+bool hal_hlvd_stable(void);
+
+bool hal_remote_clock(void);
+bool hal_remote_data(void);
+void hal_remote_set_data(bool level);
+void hal_remote_data_output(bool output);
+
+// emulated environment, it may be changed by the host program between the runs or from the hook
+typedef struct
+{
+	bool ac; // mains present
+	uint8_t ac_decimation; // only every n-th mains edge is emulated and timer5 shows the nominal period, 1 means every edge
+	uint8_t frame_decimation; // timer1 frames come in batches of n at once (divisor of 480, a minute), 1 means every frame on its time
+	bool controls; // controls scan timer emulated (it's the most frequent interrupt)
+	uint8_t selection; // rotary controller position (FUNCTION_*)
+	bool remote_clock; // PGC level driven by the remote
+	bool remote_data; // PGD level driven by the remote, it's read while the firmware doesn't drive PGD itself
+}
+host_environment_t;
+
+extern host_environment_t host_environment;
+
+// simulated time in us since the host start
+extern uint64_t host_time;
+
+extern uint8_t host_eeprom[1024];
+extern uint32_t host_eeprom_writes[1024];
+
+// called after every emulated interrupt, host program may check the state or change the environment there
+extern void (*host_hook)(void);
+
+// another device sharing the simulated time (emulated remote module), the firmware runs until the time reaches
+// wake_time, then the device is run and it sets its next wake_time (UINT64_MAX when it waits for nothing)
+// PGC change made by the device raises the interrupt-on-change like the real pin
+typedef struct
+{
+	uint64_t wake_time;
+	void (*run)(void);
+	void (*remote_data_changed)(bool output, bool level); // PGD driven by the firmware has changed
+}
+host_peer_t;
+
+extern host_peer_t* host_peer;
+
+// RTCC time in seconds since 2000-01-01
+void host_rtcc_set(uint32_t seconds);
+uint32_t host_rtcc_get(void);
+
+// runs the firmware entry until the given simulated time elapses, returns false if the firmware reset itself
+bool host_run(void (*entry)(void), uint64_t duration);
+void host_stop(void);
@@ -0,0 +1,43 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../hal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// firmware entry, main.c is built with main renamed
+void firmware_main(void);
+
+int main(int argc, char* argv[])
+{
+	// usage: firmware_host [simulated minutes]
+	uint32_t minutes = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 10) : 24 * 60;
+
+	// 2021-06-01 06:00, a season day
+	host_rtcc_set((uint32_t)(7822 * 86400UL + 6 * 3600UL));
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	bool reset = !host_run(firmware_main, minutes * 60000000ULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("simulated %u min in %.3f s%s\n", minutes, elapsed, reset ? ", firmware reset itself" : "");
+
+	return reset ? 1 : 0;
+}
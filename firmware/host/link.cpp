@@ -0,0 +1,329 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Remote link rig, runs the host build of the firmware together with the emulated remote module (remote.ino
+// built against remote/host) joined by a simulated PGC/PGD wire, then makes web requests to the module
+// and checks they reached the unit. Requests may overlap, the module serves them concurrently.
+//
+// usage: link [-d wire delay us] [-j wire jitter us] [-s seed] [-v trace.vcd]
+
+#include "wire.h"
+
+extern "C"
+{
+// structures of the firmware are packed
+#pragma pack(push, 1)
+#include "../stations.h"
+#include "../programs.h"
+#pragma pack(pop)
+
+void firmware_main(void);
+extern station_state_t stations_states[NUMBER_OF_STATIONS];
+}
+
+#include "../../remote/host/esp_host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+// module boots after the unit, like when both are powered up together
+#define ESP_BOOT_TIME 2000000ULL
+
+// 2021-06-01 06:00 unit time (UTC+2), the module's system time is 30 s ahead
+#define UNIT_TIME (7822 * 86400UL + 6 * 3600UL)
+#define SYSTEM_TIME ((uint64_t)(946684800UL + UNIT_TIME - 7200 + 30) * 1000000)
+
+static host_peer_t peer;
+
+// requests made to the module and checks of the unit state after them
+typedef struct
+{
+	double time; // seconds since the start
+	const char* uri; // nullptr when it's just a check
+	int code;
+	bool (*check)(const std::string& content);
+	const char* description;
+	bool post;
+	bool conditional; // request has the ETag of the last response
+	bool overlap; // request is made while the previous ones are still open
+}
+step_t;
+
+static bool check_time(const std::string&)
+{
+	// unit time is set at the module boot to the whole second
+	int64_t unit = host_rtcc_get();
+	int64_t system = (int64_t)((SYSTEM_TIME + host_time) / 1000000) - 946684800 + 7200;
+	return llabs(unit - system) <= 1;
+}
+
+static bool check_unit_info(const std::string& content)
+{
+	return content.find("Hz, missing cycles") != std::string::npos && content.find("not available") == std::string::npos;
+}
+
+static bool check_station_queued(const std::string&)
+{
+	return stations_states[0].run_time > 0 && stations_states[0].run_time <= 120;
+}
+
+static bool check_station_shown(const std::string& content)
+{
+	return content.find("size=\"3\"> 00:0") != std::string::npos;
+}
+
+static bool check_stations_stopped(const std::string&)
+{
+	for (uint8_t n = 0; n < NUMBER_OF_STATIONS; ++n)
+		if (stations_states[n].run_time > 0 || stations_states[n].open)
+			return false;
+	return true;
+}
+
+static bool check_seasonal_adjustment(const std::string&)
+{
+	return programs_seasonal_adjustment == 7;
+}
+
+static bool check_asset(const std::string& content)
+{
+	// gzip header
+	return content.size() > 18 && (uint8_t)content[0] == 0x1F && (uint8_t)content[1] == 0x8B;
+}
+
+static bool check_diagnostics(const std::string& content)
+{
+	return content.find("longest frame") != std::string::npos && content.find("not available") == std::string::npos;
+}
+
+static bool check_capture(const std::string& content)
+{
+	// the unit info request in between is at least a few hundred clock pulses
+	size_t pulses = 0;
+	for (size_t position = 0; (position = content.find("\n1c\n", position)) != std::string::npos; ++position)
+		pulses++;
+	return content.find("$enddefinitions") != std::string::npos && pulses > 200;
+}
+
+static bool check_api_status(const std::string& content)
+{
+	return content.find("\"time\":\"2021-06-01T06:00\"") != std::string::npos && content.find("\"seasonal_adjustment\":7") != std::string::npos;
+}
+
+static bool check_api_programs(const std::string& content)
+{
+	size_t programs = 0;
+	for (size_t position = 0; (position = content.find("\"run_times\":[", position)) != std::string::npos; ++position)
+		programs++;
+	return programs == NUMBER_OF_PROGRAMS && content.find("\"calendar\":{\"type\":") != std::string::npos;
+}
+
+static bool check_api_ok(const std::string& content)
+{
+	return content == "{\"ok\":true}";
+}
+
+static bool check_api_station_queued(const std::string&)
+{
+	return stations_states[1].run_time > 0 && stations_states[1].run_time <= 180;
+}
+
+static bool check_api_station_shown(const std::string& content)
+{
+	return content.find("\"stations\":[0,") != std::string::npos && content.find("\"stations\":[0,0,") == std::string::npos;
+}
+
+static bool check_api_time(const std::string& content)
+{
+	// unit time is in UTC
+	return content.find("\"unit\":\"2021-06-01T04:00:") != std::string::npos && content.find("\"offset_ms\":") != std::string::npos;
+}
+
+static const step_t steps[] =
+{
+	{ 4, nullptr, 0, check_time, "unit time set at the module boot" },
+	{ 5, "/", 200, check_unit_info, "unit info shown" },
+	{ 6, "/startStations?station_1=2", 303, nullptr, nullptr },
+	{ 7, nullptr, 0, check_station_queued, "station 1 queued" },
+	{ 8, "/", 200, check_station_shown, "station 1 run time shown" },
+	{ 9, "/stopStations", 303, nullptr, nullptr },
+	{ 10, nullptr, 0, check_stations_stopped, "stations stopped" },
+	{ 11, "/seasonalAdjustment?adjustment=7", 303, nullptr, nullptr },
+	{ 12, nullptr, 0, check_seasonal_adjustment, "seasonal adjustment changed" },
+	{ 13, "/diagnostics", 200, check_diagnostics, "diagnostics shown" },
+	{ 13.5, "/style.css", 200, check_asset, "stylesheet gzipped" },
+	{ 14, "/updateTime", 303, nullptr, nullptr },
+	{ 15, "/capture", 303, nullptr, nullptr },
+	{ 16, "/", 200, check_unit_info, "unit info shown" },
+	{ 17, "/capture.vcd", 200, check_capture, "capture downloaded" },
+	{ 18, "/api/v1/programs", 200, check_api_programs, "programs in JSON" },
+	{ 19, "/api/v1/status", 200, check_api_status, "status in JSON" },
+	{ 19.5, "/api/v1/status", 304, nullptr, "status not modified, cached", false, true },
+	{ 21, "/api/v1/status", 304, nullptr, "status not modified, read again", false, true },
+	{ 22, "/api/v1/stations/start?station_2=3", 200, check_api_ok, nullptr, true },
+	{ 23, nullptr, 0, check_api_station_queued, "station 2 queued" },
+	{ 24, "/api/v1/status", 200, check_api_station_shown, "status changed", false, true },
+	{ 25, "/api/v1/stations/stop", 404, nullptr, "command needs POST" },
+	{ 26, "/api/v1/seasonalAdjustment?adjustment=16", 400, nullptr, "adjustment out of range", true },
+	{ 27, "/api/v1/stations/stop", 200, check_api_ok, nullptr, true },
+	{ 28, nullptr, 0, check_stations_stopped, "stations stopped" },
+	{ 29, "/api/v1/time", 200, check_api_time, "time in JSON" },
+	{ 30, nullptr, 0, check_time, "unit time kept" },
+	{ 30.5, "/api/v1/status", 200, nullptr, "status read again" },
+	{ 31, "/api/v1/programs", 200, check_api_programs, "programs read again" },
+	{ 31, "/", 200, check_unit_info, "unit info shown meanwhile", false, false, true },
+	{ 31, "/diagnostics", 200, check_diagnostics, "diagnostics shown meanwhile", false, false, true },
+	{ 31, "/api/v1/status", 304, nullptr, "status not modified, cached while the link is busy", false, true, true },
+	{ 34, nullptr, 0, check_stations_stopped, "stations kept stopped" },
+};
+
+struct open_request_t
+{
+	size_t step;
+	int id;
+	uint64_t time;
+};
+
+static size_t step = 0;
+static std::string etag;
+static std::vector<open_request_t> open_requests;
+static unsigned failures = 0;
+
+static uint64_t step_time(size_t n)
+{
+	return (uint64_t)(steps[n].time * 1000000);
+}
+
+static void report(const step_t& s, bool ok, const char* detail)
+{
+	printf("%7.3f s  %-42s %-8s %s\n", host_time / 1e6, s.uri ? s.uri : "", ok ? "ok" : "FAILED", detail);
+	if (!ok)
+		failures++;
+}
+
+static void peer_run(void)
+{
+	// wire changes reaching the other side
+	wire_deliver();
+
+	// next step waits for the open requests unless it overlaps them
+	while (step < sizeof(steps) / sizeof(steps[0]) && host_time >= step_time(step) && (open_requests.empty() || steps[step].overlap))
+	{
+		const step_t& s = steps[step];
+		if (s.uri)
+		{
+			static const std::string no_data;
+			int id = esp_host_request(s.uri, s.post ? &no_data : nullptr, s.conditional ? "If-None-Match: " + etag : std::string());
+			open_requests.push_back({ step, id, host_time });
+		}
+		else
+		{
+			report(s, s.check(std::string()), s.description);
+		}
+		step++;
+	}
+
+	if (host_time >= ESP_BOOT_TIME && esp_host_wake_time() <= host_time)
+		esp_host_run(host_time);
+
+	for (auto request = open_requests.begin(); request != open_requests.end(); )
+	{
+		int code;
+		std::string content, headers;
+		if (!esp_host_response(request->id, &code, &content, &headers))
+		{
+			++request;
+			continue;
+		}
+
+		const step_t& s = steps[request->step];
+
+		size_t position = headers.find("ETag: ");
+		if (position != std::string::npos)
+			etag = headers.substr(position + 6, headers.find('\n', position) - position - 6);
+
+		char detail[128];
+		snprintf(detail, sizeof(detail), "%d in %.1f ms%s%s", code, (host_time - request->time) / 1e3, s.description ? ", " : "", s.description ? s.description : "");
+		report(s, code == s.code && (!s.check || s.check(content)), detail);
+
+		request = open_requests.erase(request);
+	}
+
+	uint64_t wake = std::max<uint64_t>(esp_host_wake_time(), ESP_BOOT_TIME);
+	wake = std::min(wake, wire_next_change());
+	if (step < sizeof(steps) / sizeof(steps[0]) && (open_requests.empty() || steps[step].overlap))
+		wake = std::min(wake, step_time(step));
+	peer.wake_time = std::max(wake, host_time);
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned seed = 1;
+	const char* trace = nullptr;
+	for (int n = 1; n < argc; ++n)
+	{
+		if (strcmp(argv[n], "-d") == 0 && n + 1 < argc)
+			wire_faults.delay = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-j") == 0 && n + 1 < argc)
+			wire_faults.jitter = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-s") == 0 && n + 1 < argc)
+			seed = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-v") == 0 && n + 1 < argc)
+			trace = argv[++n];
+		else
+		{
+			fprintf(stderr, "usage: link [-d wire delay us] [-j wire jitter us] [-s seed] [-v trace.vcd]\n");
+			return 2;
+		}
+	}
+	// module's mktime and gmtime work in UTC like on ESP
+	setenv("TZ", "UTC", 1);
+	tzset();
+
+	host_rtcc_set(UNIT_TIME);
+
+	peer.wake_time = 0;
+	peer.run = peer_run;
+	host_peer = &peer;
+
+	wire_init(&peer, seed);
+	if (trace && !wire_trace(trace))
+	{
+		fprintf(stderr, "can't write %s\n", trace);
+		return 2;
+	}
+	esp_host_start(SYSTEM_TIME);
+
+	printf("wire delay %u us, jitter %u us\n", wire_faults.delay, wire_faults.jitter);
+
+	bool reset = !host_run(firmware_main, step_time(sizeof(steps) / sizeof(steps[0]) - 1) + 1);
+	if (reset)
+	{
+		printf("firmware reset itself\n");
+		failures++;
+	}
+	if (step < sizeof(steps) / sizeof(steps[0]) || !open_requests.empty())
+	{
+		printf("%zu steps not done\n", sizeof(steps) / sizeof(steps[0]) - step + open_requests.size());
+		failures++;
+	}
+
+	return failures ? 1 : 0;
+}
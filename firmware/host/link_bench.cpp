@@ -0,0 +1,305 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Remote link benchmark, runs packet transfers between the emulated remote module (remote/packet.cpp and io.cpp
+// without the sketch) and the host build of the firmware over the simulated wire. It sweeps the bit timing
+// of the module and the payload sizes and reports goodput, latencies, CRC failures and timeouts of both
+// directions: packet_send() of the module received by the firmware and the firmware's send_packet() read
+// by packet_receive() of the module.
+//
+// usage: link_bench [-n transfers] [-d wire delay us] [-j wire jitter us] [-o optocoupler delay us]
+//                   [-x stuck PGD changes in 10000] [-t stuck time us] [-s seed] [-v trace.vcd]
+//
+// Jitter stands for interrupts of the module's WiFi stack delaying its edges, the optocoupler delay is added
+// to the edges pulling the lines LOW and the stuck PGD keeps its previous level for the stuck time.
+// Every failed transfer is counted once, by the reason seen by the receiving side. Goodput is the payload
+// of the successful transfers over the time of all of them, latencies are of the successful ones.
+
+#include "wire.h"
+
+extern "C"
+{
+// structures of the firmware are packed
+#pragma pack(push, 1)
+#include "../stations.h"
+#include "../scheduler.h"
+#include "../profiler.h"
+#include "../remote.h"
+#pragma pack(pop)
+
+void firmware_main(void);
+}
+
+#include <Arduino.h>
+#include "../../remote/host/esp_host.h"
+#include "../../remote/packet.h"
+#include "../../remote/io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// module boots after the unit, like when both are powered up together
+#define ESP_BOOT_TIME 2000000ULL
+
+// time given to the unit to finish the transfer before the next one, it ends a packet after 200us without clock
+#define TRANSFER_GAP_MS 2
+
+// first payload byte of the sent packets, the unit ignores unknown commands
+#define BENCHMARK_COMMAND 0xC0
+
+typedef struct
+{
+	unsigned setup;
+	unsigned pulse;
+}
+bit_timing_t;
+
+// module's nominal timing is 25/50us, the unit waits for every clock edge no longer than 200us
+static const bit_timing_t bit_timings[] =
+{
+	{ 10, 20 },
+	{ 15, 30 },
+	{ 25, 50 },
+	{ 50, 100 },
+	{ 75, 150 },
+	{ 100, 200 },
+};
+
+static const uint8_t send_sizes[] = { 1, 2, 8, 16, 31 };
+
+typedef struct
+{
+	uint8_t command;
+	uint8_t size;
+}
+response_t;
+
+// responses of the unit, sizes as the firmware packs them
+static const response_t responses[] =
+{
+	{ 0xB3, 9 },
+	{ 0xB2, 3 + 2 * SCHEDULER_TASKS },
+	{ 0xB1, 6 + 2 * NUMBER_OF_STATIONS + 6 },
+#ifdef PROFILER_ENABLED
+	{ 0xB4, 1 + sizeof(profiler_stats_t) },
+#endif
+};
+
+typedef struct
+{
+	unsigned ok;
+	unsigned crc_errors;
+	unsigned size_errors;
+	unsigned timeouts;
+	uint64_t payload;
+	uint64_t time;
+	std::vector<unsigned> latencies;
+}
+case_result_t;
+
+static unsigned transfers = 20;
+static host_peer_t peer;
+static bool suite_done = false;
+
+static unsigned percentile(const std::vector<unsigned>& sorted, unsigned p)
+{
+	return sorted.empty() ? 0 : sorted[(sorted.size() - 1) * p / 100];
+}
+
+static void report(const char* direction, unsigned size, case_result_t& result)
+{
+	std::sort(result.latencies.begin(), result.latencies.end());
+	const std::vector<unsigned>& l = result.latencies;
+
+	printf("  %-8s %4u %4u/%-4u %8.0f  %7.2f %7.2f %7.2f %7.2f  %5u %5u %5u\n", direction, size, result.ok, transfers,
+		result.time ? result.payload * 1e6 / result.time : 0.0,
+		(l.empty() ? 0 : l.front()) / 1e3, percentile(l, 50) / 1e3, percentile(l, 95) / 1e3, (l.empty() ? 0 : l.back()) / 1e3,
+		result.crc_errors, result.size_errors, result.timeouts);
+	fflush(stdout);
+}
+
+static void benchmark_send(uint8_t size)
+{
+	case_result_t result = {};
+
+	uint8_t data[31];
+	for (unsigned n = 0; n < transfers; ++n)
+	{
+		data[0] = BENCHMARK_COMMAND;
+		for (uint8_t i = 1; i < size; ++i)
+			data[i] = (uint8_t)rand();
+
+		remote_stats_t before = remote_stats;
+
+		unsigned long start = micros();
+		bool sent = packet_send(data, size);
+		unsigned long latency = micros() - start;
+		delay(TRANSFER_GAP_MS);
+
+		// the unit's view tells whether the packet made it
+		result.time += latency;
+		if (sent && remote_stats.received != before.received)
+		{
+			result.ok++;
+			result.payload += size;
+			result.latencies.push_back(latency);
+		}
+		else if (remote_stats.crc_errors != before.crc_errors)
+			result.crc_errors++;
+		else if (remote_stats.length_errors != before.length_errors)
+			result.size_errors++;
+		else
+			result.timeouts++;
+	}
+
+	report("send", size, result);
+}
+
+static void benchmark_receive(const response_t& response)
+{
+	case_result_t result = {};
+
+	uint8_t data[255];
+	for (unsigned n = 0; n < transfers; ++n)
+	{
+		unsigned long start = micros();
+		bool received = packet_send(&response.command, 1) && packet_receive(data, response.size);
+		unsigned long latency = micros() - start;
+		delay(TRANSFER_GAP_MS);
+
+		result.time += latency;
+		if (received)
+		{
+			result.ok++;
+			result.payload += response.size;
+			result.latencies.push_back(latency);
+		}
+		else if (packet_error() == PACKET_CRC)
+			result.crc_errors++;
+		else if (packet_error() == PACKET_SIZE)
+			result.size_errors++;
+		else
+			result.timeouts++;
+	}
+
+	report("receive", response.size, result);
+}
+
+void setup(void)
+{
+	io_init();
+}
+
+void loop(void)
+{
+	for (const bit_timing_t& timing : bit_timings)
+	{
+		io_bitTiming(timing.setup, timing.pulse);
+
+		printf("\nbit timing %u/%u/%u us\n", timing.setup, timing.pulse, timing.setup);
+		printf("  %-8s %4s %9s %8s  %7s %7s %7s %7s  %5s %5s %5s\n", "", "size", "ok", "B/s", "min ms", "p50 ms", "p95 ms", "max ms", "crc", "size", "t/o");
+
+		for (uint8_t size : send_sizes)
+			benchmark_send(size);
+		for (const response_t& response : responses)
+			benchmark_receive(response);
+	}
+
+	suite_done = true;
+	for (;;)
+		delay(1000);
+}
+
+static void peer_run(void)
+{
+	// wire changes reaching the other side
+	wire_deliver();
+
+	if (host_time >= ESP_BOOT_TIME && esp_host_wake_time() <= host_time)
+		esp_host_run(host_time);
+
+	if (suite_done)
+		host_stop();
+
+	uint64_t wake = std::max<uint64_t>(esp_host_wake_time(), ESP_BOOT_TIME);
+	wake = std::min(wake, wire_next_change());
+	peer.wake_time = std::max(wake, host_time);
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned seed = 1;
+	const char* trace = nullptr;
+	for (int n = 1; n < argc; ++n)
+	{
+		if (strcmp(argv[n], "-n") == 0 && n + 1 < argc)
+			transfers = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-d") == 0 && n + 1 < argc)
+			wire_faults.delay = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-j") == 0 && n + 1 < argc)
+			wire_faults.jitter = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-o") == 0 && n + 1 < argc)
+			wire_faults.opto_delay = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-x") == 0 && n + 1 < argc)
+			wire_faults.stuck_rate = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-t") == 0 && n + 1 < argc)
+			wire_faults.stuck_time = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-s") == 0 && n + 1 < argc)
+			seed = (unsigned)strtoul(argv[++n], NULL, 10);
+		else if (strcmp(argv[n], "-v") == 0 && n + 1 < argc)
+			trace = argv[++n];
+		else
+		{
+			fprintf(stderr, "usage: link_bench [-n transfers] [-d wire delay us] [-j wire jitter us] [-o optocoupler delay us] [-x stuck PGD changes in 10000] [-t stuck time us] [-s seed] [-v trace.vcd]\n");
+			return 2;
+		}
+	}
+	srand(seed);
+
+	peer.wake_time = 0;
+	peer.run = peer_run;
+	host_peer = &peer;
+
+	wire_init(&peer, seed);
+	if (trace && !wire_trace(trace))
+	{
+		fprintf(stderr, "can't write %s\n", trace);
+		return 2;
+	}
+	esp_host_start(0);
+
+	printf("wire delay %u us, jitter %u us, optocoupler delay %u us, stuck PGD %u/10000 for %u us, %u transfers a case\n",
+		wire_faults.delay, wire_faults.jitter, wire_faults.opto_delay, wire_faults.stuck_rate, wire_faults.stuck_time, transfers);
+
+	// the suite stops the run when it's done
+	bool reset = !host_run(firmware_main, 3600 * 1000000ULL);
+	if (reset)
+	{
+		printf("firmware reset itself\n");
+		return 1;
+	}
+	if (!suite_done)
+	{
+		printf("suite not finished\n");
+		return 1;
+	}
+
+	printf("\nwire changes %u, stuck %u, simulated %.1f s\n", wire_stats.changes, wire_stats.stuck, host_time / 1e6);
+	return 0;
+}
@@ -0,0 +1,430 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Season simulator, runs the firmware through months of simulated time with rain sensor and mains traces
+// and reports how the stations were watered, it fails when the firmware resets itself or the rain doesn't stop
+// the watering in time.
+//
+// usage: season [-s YYYY-MM-DD] [-d days] [-c config] [-r rain trace] [-a mains outages trace] [-n nights.csv]
+//
+// config file lines:
+//   seasonal <10-150>                      seasonal adjustment in percent
+//   program <1-8> <HH:MM> <days> <run times of stations 1-8 in minutes>
+//     days are weekdays Monday first with '-' for the skipped ones (M-W-F--), every<1-8>, odd or even
+// trace file lines (rain sensor wet or mains out):
+//   YYYY-MM-DD HH:MM <minutes>
+
+#include "hal.h"
+
+// structures of the firmware are packed
+#pragma pack(push, 1)
+#include "programs.h"
+#include "stations.h"
+#include "calendar.h"
+#include "eeprom.h"
+#include "power.h"
+#pragma pack(pop)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// firmware entry, main.c is built with main renamed
+void firmware_main(void);
+
+extern station_state_t stations_states[NUMBER_OF_STATIONS];
+
+// watering night runs from noon to noon
+#define NIGHT_START (12 * 3600)
+
+// rain starting while valves are open has to close them in this time, it fails the run otherwise
+#define RAIN_STOP_MAX 5 // s
+
+typedef struct
+{
+	uint32_t start;
+	uint32_t end;
+}
+interval_t;
+
+typedef struct
+{
+	interval_t* intervals;
+	size_t count;
+	size_t next;
+}
+trace_t;
+
+static trace_t rain_trace;
+static trace_t ac_trace;
+
+static struct
+{
+	uint64_t last_time;
+	uint8_t last_open;
+
+	uint64_t water_time[NUMBER_OF_STATIONS];
+	uint32_t starts[NUMBER_OF_STATIONS];
+	uint64_t concurrency_time[NUMBER_OF_STATIONS + 1];
+
+	uint32_t night;
+	uint32_t night_first_open;
+	uint32_t night_last_close;
+	bool night_watered;
+
+	uint32_t nights_watered;
+	uint32_t window_min;
+	uint32_t window_max;
+	uint64_t window_sum;
+
+	uint32_t rain_minutes;
+	uint32_t outage_minutes;
+
+	bool last_rain;
+	uint64_t rain_stop_start; // 0 when no watering waits for the rain to stop it
+	uint32_t rain_stops;
+	uint64_t rain_stop_max;
+}
+stats;
+
+static FILE* nights_file = NULL;
+
+static void fail(const char* file, int line, const char* message)
+{
+	fprintf(stderr, "%s:%d: %s\n", file, line, message);
+	exit(2);
+}
+
+static bool parse_date(const char* text, int* year, int* month, int* day)
+{
+	return (sscanf(text, "%d-%d-%d", year, month, day) == 3 && *year >= 2000 && *year <= 2099 && *month >= 1 && *month <= 12 && *day >= 1 && *day <= calendar_month_days(*year - 2000, *month));
+}
+
+static uint32_t date_seconds(int year, int month, int day)
+{
+	return calendar_epoch_day(year - 2000, month, day) * 86400UL;
+}
+
+static void load_trace(const char* path, trace_t* trace)
+{
+	FILE* f = fopen(path, "r");
+	if (!f)
+		fail(path, 0, "can't open");
+
+	char line[128];
+	int line_number = 0;
+	while (fgets(line, sizeof(line), f))
+	{
+		++line_number;
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == 0)
+			continue;
+
+		char date[16];
+		int year, month, day, hours, minutes;
+		unsigned duration;
+		if (sscanf(line, "%15s %d:%d %u", date, &hours, &minutes, &duration) != 4 || !parse_date(date, &year, &month, &day) || hours > 23 || minutes > 59)
+			fail(path, line_number, "expected YYYY-MM-DD HH:MM <minutes>");
+
+		trace->intervals = realloc(trace->intervals, (trace->count + 1) * sizeof(interval_t));
+		interval_t* interval = &trace->intervals[trace->count++];
+		interval->start = date_seconds(year, month, day) + hours * 3600 + minutes * 60;
+		interval->end = interval->start + duration * 60;
+
+		if (trace->count > 1 && interval->start < interval[-1].start)
+			fail(path, line_number, "intervals must be in time order");
+	}
+
+	fclose(f);
+}
+
+static bool trace_active(trace_t* trace, uint32_t time)
+{
+	while (trace->next < trace->count && trace->intervals[trace->next].end <= time)
+		trace->next++;
+
+	return (trace->next < trace->count && trace->intervals[trace->next].start <= time);
+}
+
+static void load_config(const char* path, uint16_t start_epoch_day)
+{
+	FILE* f = fopen(path, "r");
+	if (!f)
+		fail(path, 0, "can't open");
+
+	char line[256];
+	int line_number = 0;
+	while (fgets(line, sizeof(line), f))
+	{
+		++line_number;
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == 0)
+			continue;
+
+		unsigned value;
+		if (sscanf(line, "seasonal %u", &value) == 1)
+		{
+			if (value < 10 || value > 150 || value % 10)
+				fail(path, line_number, "seasonal adjustment is 10-150% in 10% steps");
+			programs_seasonal_adjustment = value / 10;
+			continue;
+		}
+
+		unsigned number, hours, minutes, run_times[NUMBER_OF_STATIONS];
+		char days[16];
+		if (sscanf(line, "program %u %u:%u %15s %u %u %u %u %u %u %u %u", &number, &hours, &minutes, days,
+			&run_times[0], &run_times[1], &run_times[2], &run_times[3], &run_times[4], &run_times[5], &run_times[6], &run_times[7]) != 12)
+			fail(path, line_number, "expected program <1-8> <HH:MM> <days> <8 run times>");
+		if (number < 1 || number > NUMBER_OF_PROGRAMS || hours > 23 || minutes > 59)
+			fail(path, line_number, "program number or start time out of range");
+
+		program_t* program = &programs[number - 1];
+		program->start_time.hour = number_to_bcd(hours);
+		program->start_time.minute = number_to_bcd(minutes);
+
+		unsigned interval;
+		if (sscanf(days, "every%u", &interval) == 1 && interval >= 1 && interval <= 8)
+		{
+			// first day of the simulation is the watering one
+			program->calendar.repeat_bits = 0b10;
+			program->calendar.days = interval - 1;
+			program->calendar.offset = start_epoch_day % interval;
+		}
+		else if (strcmp(days, "odd") == 0 || strcmp(days, "even") == 0)
+		{
+			program->calendar.odd_even_bits = 0b110;
+			program->calendar.unused = 0;
+			program->calendar.odd_even = (days[0] == 'o');
+		}
+		else if (strlen(days) == 7)
+		{
+			program->calendar.weekdays_bit = 0;
+			program->calendar.weekdays_mask = 0;
+			for (uint8_t n = 0; n < 7; ++n)
+				if (days[n] != '-')
+					program->calendar.weekdays_mask |= (1 << n);
+		}
+		else
+			fail(path, line_number, "days are 7 weekday characters, every<1-8>, odd or even");
+
+		for (uint8_t m = 0; m < NUMBER_OF_STATIONS; ++m)
+		{
+			if (run_times[m] > 240)
+				fail(path, line_number, "run time is 0-240 minutes");
+			program->run_times[m] = run_times[m];
+		}
+	}
+
+	fclose(f);
+}
+
+static void night_finish(void)
+{
+	uint32_t window = stats.night_watered ? stats.night_last_close - stats.night_first_open : 0;
+	if (stats.night_watered)
+	{
+		if (stats.nights_watered == 0 || window < stats.window_min)
+			stats.window_min = window;
+		if (window > stats.window_max)
+			stats.window_max = window;
+		stats.window_sum += window;
+		stats.nights_watered++;
+	}
+
+	if (nights_file)
+	{
+		time_t date = (time_t)stats.night * 86400 + NIGHT_START + 946684800;
+		struct tm tm;
+		gmtime_r(&date, &tm);
+		fprintf(nights_file, "%04d-%02d-%02d,%u\n", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, window / 60);
+	}
+
+	stats.night_watered = false;
+}
+
+static void hook(void)
+{
+	uint32_t now = host_rtcc_get();
+
+	// inputs for the next period
+	bool rain = trace_active(&rain_trace, now);
+	bool outage = trace_active(&ac_trace, now);
+	PORTGbits.RG3 = rain;
+	host_environment.ac = !outage;
+
+	// account the period since the last hook to the state valid during it
+	uint64_t elapsed = host_time - stats.last_time;
+	stats.last_time = host_time;
+
+	uint8_t open = 0;
+	uint8_t count = 0;
+	for (uint8_t m = 0; m < NUMBER_OF_STATIONS; ++m)
+	{
+		if (stats.last_open & (1 << m))
+		{
+			stats.water_time[m] += elapsed;
+			count++;
+		}
+		if (stations_states[m].open)
+			open |= (1 << m);
+	}
+	stats.concurrency_time[count] += elapsed;
+
+	uint32_t night = (now - NIGHT_START) / 86400;
+	if (night != stats.night)
+	{
+		night_finish();
+		stats.night = night;
+	}
+
+	for (uint8_t m = 0; m < NUMBER_OF_STATIONS; ++m)
+		if (open & ~stats.last_open & (1 << m))
+			stats.starts[m]++;
+
+	if (open && !stats.night_watered)
+	{
+		stats.night_watered = true;
+		stats.night_first_open = now;
+	}
+	if (stats.last_open && !open)
+		stats.night_last_close = now;
+
+	static uint32_t last_minute = 0;
+	if (now / 60 != last_minute)
+	{
+		last_minute = now / 60;
+		stats.rain_minutes += rain;
+		stats.outage_minutes += outage;
+	}
+
+	// time from the sensor turning wet to all valves closed
+	if (rain && !stats.last_rain && open)
+		stats.rain_stop_start = host_time;
+	if (stats.rain_stop_start && !open)
+	{
+		uint64_t stop = host_time - stats.rain_stop_start;
+		if (stop > stats.rain_stop_max)
+			stats.rain_stop_max = stop;
+		stats.rain_stops++;
+		stats.rain_stop_start = 0;
+	}
+
+	stats.last_open = open;
+	stats.last_rain = rain;
+
+	// frames go by a second at once unless valves are open or the mains is out, the watering, the power handling
+	// and the rain sensor keep their timing
+	host_environment.frame_decimation = (open || outage) ? 1 : 8;
+}
+
+int main(int argc, char* argv[])
+{
+	int year = 2021, month = 4, day = 1;
+	unsigned days = 365;
+	const char* config_path = NULL;
+
+	for (int n = 1; n < argc; ++n)
+	{
+		const char* value = (n + 1 < argc) ? argv[n + 1] : NULL;
+		if (strcmp(argv[n], "-s") == 0 && value && parse_date(value, &year, &month, &day))
+			++n;
+		else if (strcmp(argv[n], "-d") == 0 && value && (days = strtoul(value, NULL, 10)) > 0)
+			++n;
+		else if (strcmp(argv[n], "-c") == 0 && value)
+			config_path = argv[++n];
+		else if (strcmp(argv[n], "-r") == 0 && value)
+			load_trace(argv[++n], &rain_trace);
+		else if (strcmp(argv[n], "-a") == 0 && value)
+			load_trace(argv[++n], &ac_trace);
+		else if (strcmp(argv[n], "-n") == 0 && value)
+		{
+			if (!(nights_file = fopen(argv[++n], "w")))
+				fail(argv[n], 0, "can't create");
+			fprintf(nights_file, "night,window_minutes\n");
+		}
+		else
+		{
+			fprintf(stderr, "usage: season [-s YYYY-MM-DD] [-d days] [-c config] [-r rain trace] [-a mains outages trace] [-n nights.csv]\n");
+			return 2;
+		}
+	}
+
+	uint32_t start = date_seconds(year, month, day);
+
+	// configuration is stored to EEPROM the way the firmware does it, so it's restored at the start
+	programs_defaults();
+	if (config_path)
+		load_config(config_path, start / 86400);
+	programs_save();
+	eeprom_validate();
+	programs_save();
+	memset(host_eeprom_writes, 0, sizeof(host_eeprom_writes));
+
+	// nobody turns the controls, so their scan parks itself, and the mains is followed just by an edge a second,
+	// idle frames are batched by the hook, it's what makes it fast
+	host_environment.ac_decimation = 50;
+	host_hook = hook;
+
+	host_rtcc_set(start);
+	stats.night = (start - NIGHT_START) / 86400;
+
+	struct timespec clock_start, clock_end;
+	clock_gettime(CLOCK_MONOTONIC, &clock_start);
+	bool reset = !host_run(firmware_main, days * 86400000000ULL);
+	clock_gettime(CLOCK_MONOTONIC, &clock_end);
+	night_finish();
+
+	double elapsed = (clock_end.tv_sec - clock_start.tv_sec) + (clock_end.tv_nsec - clock_start.tv_nsec) / 1e9;
+	printf("simulated %04d-%02d-%02d + %u days in %.2f s%s\n", year, month, day, days, elapsed, reset ? ", firmware reset itself" : "");
+	printf("rain sensor wet %u min, mains out %u min, mains dropouts %u\n", stats.rain_minutes, stats.outage_minutes, power_ac_stats.dropouts);
+
+	bool rain_late = (stats.rain_stop_max > RAIN_STOP_MAX * 1000000ULL);
+	if (stats.rain_stops)
+		printf("rain stopped watering %u times, at most %.1f s after the sensor turned wet%s\n", stats.rain_stops, stats.rain_stop_max / 1e6, rain_late ? ", too late" : "");
+
+	printf("\nstation  water [min]  starts\n");
+	uint64_t water_total = 0;
+	for (uint8_t m = 0; m < NUMBER_OF_STATIONS; ++m)
+	{
+		printf("%7u  %11.1f  %6u\n", m + 1, stats.water_time[m] / 60e6, stats.starts[m]);
+		water_total += stats.water_time[m];
+	}
+	printf("  total  %11.1f\n", water_total / 60e6);
+
+	printf("\nvalves open  time [min]\n");
+	for (uint8_t n = 1; n <= NUMBER_OF_STATIONS; ++n)
+		if (stats.concurrency_time[n])
+			printf("%11u  %10.1f\n", n, stats.concurrency_time[n] / 60e6);
+
+	printf("\nnights watered %u", stats.nights_watered);
+	if (stats.nights_watered)
+		printf(", watering window min %u, avg %u, max %u min", stats.window_min / 60, (uint32_t)(stats.window_sum / stats.nights_watered / 60), stats.window_max / 60);
+	printf("\n");
+
+	uint32_t writes = 0, cells = 0, cell_max = 0;
+	for (uint16_t n = 0; n < sizeof(host_eeprom); ++n)
+	{
+		writes += host_eeprom_writes[n];
+		cells += (host_eeprom_writes[n] > 0);
+		if (host_eeprom_writes[n] > cell_max)
+			cell_max = host_eeprom_writes[n];
+	}
+	printf("EEPROM writes %u to %u cells, at most %u to a single cell\n", writes, cells, cell_max);
+
+	if (nights_file)
+		fclose(nights_file);
+
+	return (reset || rain_late) ? 1 : 0;
+}
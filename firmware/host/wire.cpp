@@ -0,0 +1,229 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "wire.h"
+#include "../../remote/host/esp_host.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <random>
+
+// pins of ESP-01 (remote/io.cpp)
+#define ESP_PIN_RST 1
+#define ESP_PIN_PGC 2
+#define ESP_PIN_PGD 3
+
+enum wire_line_t
+{
+	LINE_ESP_PGC,
+	LINE_ESP_PGD,
+	LINE_UNIT_PGD,
+	LINES
+};
+
+typedef struct
+{
+	bool drive;
+	bool level;
+}
+line_drive_t;
+
+typedef struct
+{
+	uint8_t line;
+	line_drive_t drive;
+}
+wire_change_t;
+
+wire_faults_t wire_faults;
+wire_stats_t wire_stats;
+
+static std::mt19937 wire_random;
+static host_peer_t* wire_peer;
+
+// drives as set by their side and as delivered to the other side
+static line_drive_t drives[LINES];
+static line_drive_t delivered[LINES];
+static uint64_t last_delivery[LINES];
+static std::multimap<uint64_t, wire_change_t> wire_changes;
+
+// module's reset output, it isn't connected to the unit
+static line_drive_t reset_drive;
+
+enum trace_signal_t
+{
+	TRACE_MODULE_RST,
+	TRACE_MODULE_PGC,
+	TRACE_MODULE_PGD,
+	TRACE_MODULE_PGD_IN,
+	TRACE_UNIT_PGC,
+	TRACE_UNIT_PGD,
+	TRACE_UNIT_PGD_IN,
+	TRACE_SIGNALS
+};
+
+static FILE* trace_file;
+static uint64_t trace_time;
+static char trace_values[TRACE_SIGNALS];
+
+static bool line_level(line_drive_t a, line_drive_t b)
+{
+	if (!a.drive && !b.drive)
+		return false;
+	return (!a.drive || a.level) && (!b.drive || b.level);
+}
+
+static char drive_value(line_drive_t drive)
+{
+	return drive.drive ? (drive.level ? '1' : '0') : 'z';
+}
+
+static void trace(uint64_t time)
+{
+	if (!trace_file)
+		return;
+
+	char values[TRACE_SIGNALS];
+	values[TRACE_MODULE_RST] = drive_value(reset_drive);
+	values[TRACE_MODULE_PGC] = drive_value(drives[LINE_ESP_PGC]);
+	values[TRACE_MODULE_PGD] = drive_value(drives[LINE_ESP_PGD]);
+	values[TRACE_MODULE_PGD_IN] = line_level(drives[LINE_ESP_PGD], delivered[LINE_UNIT_PGD]) ? '1' : '0';
+	values[TRACE_UNIT_PGC] = line_level(delivered[LINE_ESP_PGC], {}) ? '1' : '0';
+	values[TRACE_UNIT_PGD] = drive_value(drives[LINE_UNIT_PGD]);
+	values[TRACE_UNIT_PGD_IN] = line_level(delivered[LINE_ESP_PGD], {}) ? '1' : '0';
+
+	bool stamped = false;
+	for (uint8_t n = 0; n < TRACE_SIGNALS; ++n)
+	{
+		if (values[n] == trace_values[n])
+			continue;
+
+		if (!stamped)
+		{
+			trace_time = std::max(trace_time, time);
+			fprintf(trace_file, "#%llu\n", (unsigned long long)trace_time);
+			stamped = true;
+		}
+		fprintf(trace_file, "%c%c\n", values[n], '!' + n);
+		trace_values[n] = values[n];
+	}
+}
+
+static void wire_change(uint8_t line, bool drive, bool level)
+{
+	if (drives[line].drive == drive && drives[line].level == level)
+		return;
+	bool falling = drives[line].drive && drives[line].level;
+	drives[line] = { drive, level };
+
+	uint64_t time = host_time + wire_faults.delay;
+	if (wire_faults.jitter)
+		time += wire_random() % (wire_faults.jitter + 1);
+	if (falling && !(drive && level))
+		time += wire_faults.opto_delay;
+	if (line != LINE_ESP_PGC && wire_faults.stuck_rate && wire_random() % 10000 < wire_faults.stuck_rate)
+	{
+		time += wire_faults.stuck_time;
+		wire_stats.stuck++;
+	}
+	time = std::max(time, last_delivery[line]);
+	last_delivery[line] = time;
+	wire_stats.changes++;
+
+	wire_changes.insert({ time, { line, { drive, level } } });
+	if (time < wire_peer->wake_time)
+		wire_peer->wake_time = time;
+
+	trace(host_time);
+}
+
+static void esp_pin_changed(uint8_t pin, bool output, bool level)
+{
+	if (pin == ESP_PIN_RST)
+	{
+		reset_drive = { output, level };
+		trace(host_time);
+	}
+	else if (pin == ESP_PIN_PGC)
+		wire_change(LINE_ESP_PGC, output, !level);
+	else if (pin == ESP_PIN_PGD)
+		wire_change(LINE_ESP_PGD, output, !level);
+}
+
+static bool esp_pin_read(uint8_t pin)
+{
+	if (pin == ESP_PIN_PGD)
+		return !line_level(drives[LINE_ESP_PGD], delivered[LINE_UNIT_PGD]);
+	return false;
+}
+
+static void unit_data_changed(bool output, bool level)
+{
+	wire_change(LINE_UNIT_PGD, output, level);
+}
+
+void wire_init(host_peer_t* peer, unsigned seed)
+{
+	wire_random.seed(seed);
+	wire_peer = peer;
+
+	peer->remote_data_changed = unit_data_changed;
+	esp_host_pin_changed = esp_pin_changed;
+	esp_host_pin_read = esp_pin_read;
+}
+
+void wire_deliver(void)
+{
+	while (!wire_changes.empty() && wire_changes.begin()->first <= host_time)
+	{
+		const wire_change_t& change = wire_changes.begin()->second;
+		delivered[change.line] = change.drive;
+		trace(wire_changes.begin()->first);
+		wire_changes.erase(wire_changes.begin());
+	}
+	host_environment.remote_clock = delivered[LINE_ESP_PGC].drive && delivered[LINE_ESP_PGC].level;
+	host_environment.remote_data = delivered[LINE_ESP_PGD].drive && delivered[LINE_ESP_PGD].level;
+}
+
+uint64_t wire_next_change(void)
+{
+	return wire_changes.empty() ? UINT64_MAX : wire_changes.begin()->first;
+}
+
+bool wire_trace(const char* path)
+{
+	trace_file = fopen(path, "w");
+	if (!trace_file)
+		return false;
+
+	static const char* names[TRACE_SIGNALS] = { "rst", "pgc", "pgd", "pgd_in", "pgc", "pgd", "pgd_in" };
+
+	fprintf(trace_file, "$timescale 1us $end\n");
+	fprintf(trace_file, "$scope module module $end\n");
+	for (uint8_t n = TRACE_MODULE_RST; n <= TRACE_MODULE_PGD_IN; ++n)
+		fprintf(trace_file, "$var wire 1 %c %s $end\n", '!' + n, names[n]);
+	fprintf(trace_file, "$upscope $end\n");
+	fprintf(trace_file, "$scope module unit $end\n");
+	for (uint8_t n = TRACE_UNIT_PGC; n <= TRACE_UNIT_PGD_IN; ++n)
+		fprintf(trace_file, "$var wire 1 %c %s $end\n", '!' + n, names[n]);
+	fprintf(trace_file, "$upscope $end\n");
+	fprintf(trace_file, "$enddefinitions $end\n");
+
+	trace_time = host_time;
+	trace(host_time);
+	return true;
+}
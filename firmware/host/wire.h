@@ -0,0 +1,60 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Simulated PGC/PGD wire between the host firmware and the emulated remote module (remote/host).
+//
+// Wire levels are logical (the module's pins are inverted by io.cpp), LOW driver wins and undriven line
+// is pulled LOW. Every change reaches the other side after the delay plus random jitter, changes of
+// a single line keep their order.
+
+extern "C"
+{
+#include "../hal.h"
+}
+
+typedef struct
+{
+	unsigned delay; // us every change takes to reach the other side
+	unsigned jitter; // us of random delay added to every change
+	unsigned opto_delay; // us added to changes pulling a line LOW (optocoupler turns off slower than on)
+	unsigned stuck_rate; // changes of PGD in 10000 which get stuck at the previous level
+	unsigned stuck_time; // us the stuck PGD keeps the previous level
+}
+wire_faults_t;
+
+typedef struct
+{
+	uint32_t changes;
+	uint32_t stuck;
+}
+wire_stats_t;
+
+extern wire_faults_t wire_faults;
+extern wire_stats_t wire_stats;
+
+// connects the module pins and the firmware PGD to the wire, changes made by the module wake the peer
+void wire_init(host_peer_t* peer, unsigned seed);
+
+// delivers the changes due at the current simulated time to the firmware inputs
+void wire_deliver(void);
+
+// simulated time of the next change to deliver, UINT64_MAX when there's none
+uint64_t wire_next_change(void);
+
+// records the module's RST, PGC and PGD and the lines as seen by both sides to VCD file (time in us)
+bool wire_trace(const char* path);
@@ -22,52 +22,165 @@
 #include "rtcc.h"
 #include "sensor.h"
 #include "remote.h"
+#include "scheduler.h"
+#include "power.h"
+#include "benchmark.h"
+#include "profiler.h"
 #include "types.h"
 
 volatile bool ac_sensed = false;
-uint8_t ac_sense_timeout = 0;
+uint8_t ac_sensed_frame = 0;
 
 volatile bool rain_sensed = false;
 
 volatile uint8_t ticks_seconds = 0;
 volatile uint8_t ticks_fractions = 0;
+volatile uint8_t ticks_frames = 0;
+
+// precise time set was written by timer1 interrupt, the shadow and the display are refreshed by the next frame
+static volatile bool ticks_set = false;
+
+#ifdef BENCHMARK
+volatile uint8_t benchmark_marker = 0;
+#endif
+
+static uint8_t last_seconds = 0;
+static uint8_t task_minute = TASK_NONE;
+static uint8_t task_input = TASK_NONE;
 
 void sleep(void);
+static void resume(void);
+static void timer_start(void);
+static void wait_frame(uint8_t last_frame);
+static void power_fail(void);
+
+static void task_clock(void);
+static void task_programs(void);
+static void task_sensor(void);
+static void task_power(void);
+static void task_remote(void);
+static void task_ui(void);
+
+// registers changed by sleep that have to be restored on resume
+static struct
+{
+	uint8_t osccon;
+	uint8_t osccon2;
+	uint8_t pmd1;
+	uint8_t lata, latb, latc, latd, late, latf, latg, lath, latj;
+	uint8_t trisa, trisb, trisc, trisd, trise, trisf, trisg, trish, trisj;
+	uint8_t padcfg1;
+	uint8_t intcon, intcon2, intcon3;
+	uint8_t pie1, pie2, pie3, pie4, pie5, pie6;
+}
+sleep_state;
 
 void __interrupt() isr(void)
 {
+	BENCHMARK_BEGIN(BENCHMARK_ISR);
+
 	if (PIR1bits.TMR1IF)
 	{
+		if (rtcc_set_frames)
+		{
+			// precise time set waits for its second, frames keep its phase regardless of the RTCC minute
+			TMR1H = 0xFE;
+			TMR1L = 0x00;
+
+			if (--rtcc_set_frames == 0)
+			{
+				ticks_seconds = rtcc_set_begin();
+				ticks_fractions = 0;
+				ticks_set = true;
+			}
+
+			ticks_frames++;
+		}
 		// last tick of minute period will be handled in RTCC interrupt to sync it with RTCC alarm
-		if (ticks_seconds < 59 || (ticks_fractions & 7) < 7)
+		else if (ticks_seconds < 59 || (ticks_fractions & 7) < 7)
 		{
 			TMR1H = 0xFE;
 			TMR1L = 0x00;
 
 			if ((++ticks_fractions & 7) == 0)
 				ticks_seconds++;
+
+			ticks_frames++;
 		}
 
+		controls_frame();
 		PIR1bits.TMR1IF = 0;
 	}
 
 	if (PIR3bits.RTCCIF)
 	{
-		// every whole minute reset the fractions timer and count from zero again
-		TMR1H = 0xFE;
-		TMR1L = 0x00;
+		// every whole minute reset the fractions timer and count from zero again,
+		// unless a precise time set waits, it restarts the RTCC second itself
+		if (!rtcc_set_frames && !rtcc_set_pending)
+		{
+			TMR1H = 0xFE;
+			TMR1L = 0x00;
 
-		ticks_seconds = 0;
-		ticks_fractions = 0;
+			ticks_seconds = 0;
+			ticks_fractions = 0;
+
+			ticks_frames++;
+		}
 
 		PIR3bits.RTCCIF = 0;
 	}
 
+	// flags are set even when their interrupts are masked, so the masked ones are left pending till they're enabled
+	if (INTCONbits.INT0IE && INTCONbits.INT0IF)
+	{
+		power_ac_edge();
+		INTCONbits.INT0IF = 0;
+	}
+
+	if (PIE5bits.TMR5IE && PIR5bits.TMR5IF)
+	{
+		power_ac_timeout();
+		PIR5bits.TMR5IF = 0;
+	}
+
+	if (INTCON3bits.INT1IE && INTCON3bits.INT1IF)
+	{
+		controls_wake();
+		INTCON3bits.INT1IF = 0;
+	}
+
+	if (PIE5bits.TMR4IE && PIR5bits.TMR4IF)
+	{
+		controls_scan();
+		PIR5bits.TMR4IF = 0;
+	}
+
+	if (PIE5bits.TMR6IE && PIR5bits.TMR6IF)
+	{
+		sensor_charged();
+		PIR5bits.TMR6IF = 0;
+	}
+
+	if (PIE2bits.HLVDIE && PIR2bits.HLVDIF)
+	{
+		power_voltage_low();
+		PIR2bits.HLVDIF = 0;
+	}
+
 	if (PIR6bits.CMP1IF)
 	{
 		stations_overcurrent_detected();
 		PIR6bits.CMP1IF = 0;
 	}
+
+	if (INTCONbits.RBIF)
+	{
+		// PGC change only wakes the core to handle remote request, reading the port ends the mismatch
+		(void)PORTB;
+		INTCONbits.RBIF = 0;
+	}
+
+	BENCHMARK_END(BENCHMARK_ISR);
 }
 
 void main(void)
@@ -89,9 +202,14 @@ void main(void)
 	stations_init();
 	programs_init();
 	ui_init();
+	power_init();
+	profiler_init();
 
-	// INT0 on falling edge to sense AC
-	INTCON2bits.INTEDG0 = 0;
+	// interrupt-on-change on PGC to wake the core when remote starts a request
+	IOCBbits.IOCB6 = 1;
+	(void)PORTB;
+	INTCONbits.RBIF = 0;
+	INTCONbits.RBIE = 1;
 
 	// enable interrupts
 	INTCONbits.GIE = 1;
@@ -101,86 +219,231 @@ void main(void)
 	rtcc_enable_alarm();
 	rtcc_sync();
 
+	// continue the queue interrupted by a power failure
+	stations_queue_restore();
+
 	// sync timer to RTCC second tick
-	while (!RTCCFGbits.HALFSEC);
-	while (RTCCFGbits.HALFSEC);
+	hal_rtcc_wait_second();
 	PIE3bits.RTCCIE = 1;
 
-	// configure timer1 to 1:8 pre-scaler, SOSC clock source, 125ms ticks
-	T1CON = 0b10111111;
-	T1GCON = 0;
-	TMR1H = 0xFE;
-	TMR1L = 0x00;
-	PIR1bits.TMR1IF = 0;
-	PIE1bits.TMR1IE = 1;
+	timer_start();
 
-	uint8_t last_seconds = 0;
-	uint8_t last_fraction = 0;
+	// tasks are run in order they are added here, so the first ones have the highest priority
+	scheduler_add(task_clock, 1, 0, 2);
+	task_minute = scheduler_add(task_programs, 0, 0, 4);
+	scheduler_add(task_sensor, 1, 0, 2);
+	scheduler_add(task_power, 1, 0, 0);
+	scheduler_add(task_remote, 1, 0, 2);
+	task_input = scheduler_add(task_ui, 1, 0, 1);
+
+	uint8_t last_frame = ticks_frames;
 	for (;;)
 	{
 		CLRWDT();
 
-		// restart AC sense
-		INTCONbits.INT0IF = 0;
-
 		// wait for another 125ms period elapsed
-		while (last_fraction == ticks_fractions);
-		last_fraction = ticks_fractions;
+		wait_frame(last_frame);
 
-		// check if at least one whole second elapsed
-		if (last_seconds != ticks_seconds)
-		{
-			uint8_t elapsed_seconds = ((ticks_seconds >= last_seconds) ? ticks_seconds : (ticks_seconds + 60)) - last_seconds;
-			last_seconds = ticks_seconds;
+		// precise time set is written right after the interrupt which started its second, the core idles till then
+		rtcc_set_apply();
 
-			if (ticks_seconds == 0)
-			{
-				// sync current time
-				rtcc_sync();
-
-				if (ui_selection() == FUNCTION_RUN)
-				{
-					if (!rain_sensed)
-						// check program and eventually schedule stations to run
-						programs_check(&now);
-				}
-			}
+		if (power_failing())
+			power_fail();
 
-			if (ticks_seconds == 15 || ticks_seconds == 45)
-			{
-				// check the sensor every 30 seconds
-				bool rain_was_sensed = rain_sensed;
-				rain_sensed = sensor_check();
-				if (rain_sensed && !rain_was_sensed)
-				{
-					stations_queue_stop();
-
-					// sensor has just begun to detect rain, reset the program calendar offsets
-					programs_reset_calendar(&now);
-				}
-			}
+		uint8_t elapsed_frames = ticks_frames - last_frame;
+		last_frame = ticks_frames;
+
+		if (controls_pending())
+			// control events are handled right away, not at the next frame
+			scheduler_post(task_input, 0);
+
+		BENCHMARK_BEGIN(BENCHMARK_FRAME);
+		PROFILER_BEGIN(PROFILER_FRAME);
+		scheduler_run(elapsed_frames);
+		PROFILER_END(PROFILER_FRAME);
+		BENCHMARK_END(BENCHMARK_FRAME);
+	}
+
+	return;
+}
+
+static void task_clock(void)
+{
+	if (ticks_set)
+	{
+		// time was set by timer1 interrupt, the jump of seconds isn't elapsed time
+		ticks_set = false;
+		last_seconds = ticks_seconds;
+
+		rtcc_sync();
+		ui_refresh();
+
+		if (ticks_seconds == 0)
+			scheduler_post(task_minute, 0);
+		return;
+	}
+
+	// check if at least one whole second elapsed
+	if (last_seconds == ticks_seconds)
+		return;
+
+	uint8_t elapsed_seconds = ((ticks_seconds >= last_seconds) ? ticks_seconds : (ticks_seconds + 60)) - last_seconds;
+	last_seconds = ticks_seconds;
 
-			stations_queue_update(elapsed_seconds);
+	if (ticks_seconds == 0)
+		// whole minute elapsed
+		scheduler_post(task_minute, 0);
+
+	// queue is paused while there's no AC to power the valves
+	if (power_ac_present())
+	{
+		BENCHMARK_BEGIN(BENCHMARK_STATIONS_QUEUE_UPDATE);
+		stations_queue_update(elapsed_seconds);
+		BENCHMARK_END(BENCHMARK_STATIONS_QUEUE_UPDATE);
+	}
+}
+
+static void task_programs(void)
+{
+	// sync current time
+	rtcc_sync();
+
+	if (ui_selection() == FUNCTION_RUN)
+	{
+		// check program and eventually schedule stations to run
+		if (!rain_sensed)
+		{
+			BENCHMARK_BEGIN(BENCHMARK_PROGRAMS_CHECK);
+			programs_check(&now_binary);
+			BENCHMARK_END(BENCHMARK_PROGRAMS_CHECK);
 		}
+	}
+}
 
-		ui_update();
+static void task_sensor(void)
+{
+	PROFILER_BEGIN(PROFILER_SENSOR_UPDATE);
+	bool changed = sensor_update(stations_opened());
+	PROFILER_END(PROFILER_SENSOR_UPDATE);
 
-		// if any falling edge was detected on INT0, AC is sensed
-		ac_sensed = INTCONbits.INT0IF;
-		if (ac_sensed)
-			ac_sense_timeout = 0;
-		else if (++ac_sense_timeout == 40)
-			// no AC was sensed in 5 seconds, go to sleep and save the battery
-			sleep();
+	if (!changed)
+		// debounced sensor state hasn't changed
+		return;
 
-		// enable remote input, sensor bypass and current sense only if AC is sensed
-		PORTJbits.RJ0 = ac_sensed;
+	rain_sensed = sensor_rain();
+	if (rain_sensed)
+	{
+		stations_queue_stop();
 
-		// handle remote requests
-		remote_handle();
+		// sensor has just begun to detect rain, reset the program calendar offsets
+		programs_reset_calendar(&now_binary);
 	}
+}
 
-	return;
+static void task_power(void)
+{
+	// mains is followed continuously while valves are open, otherwise it's sampled once a second
+	if (stations_opened())
+		power_ac_follow();
+	else if ((ticks_fractions & 7) == 0)
+		power_ac_sample();
+
+	bool ac_was_sensed = ac_sensed;
+	ac_sensed = power_ac_present();
+
+	if (ac_was_sensed && !ac_sensed)
+	{
+		// mains has just dropped out, valves are already closed by the interrupt
+		stations_queue_pause();
+		ui_flush();
+	}
+
+	if (ac_sensed)
+		ac_sensed_frame = ticks_frames;
+	else if ((uint8_t)(ticks_frames - ac_sensed_frame) >= AC_SENSE_TIMEOUT)
+	{
+		// no AC was sensed in 5 seconds, go to sleep and save the battery
+		sleep();
+
+		// the time spent in sleep doesn't count as elapsed for the stations queue
+		ac_sensed_frame = ticks_frames;
+		last_seconds = ticks_seconds;
+	}
+
+	// enable remote input, sensor bypass and current sense only if AC is sensed
+	PORTJbits.RJ0 = ac_sensed;
+}
+
+static void task_remote(void)
+{
+	// handle remote requests
+	PROFILER_BEGIN(PROFILER_REMOTE_HANDLE);
+	remote_handle();
+	PROFILER_END(PROFILER_REMOTE_HANDLE);
+}
+
+static void task_ui(void)
+{
+	BENCHMARK_BEGIN(BENCHMARK_UI_UPDATE);
+	ui_update();
+	BENCHMARK_END(BENCHMARK_UI_UPDATE);
+}
+
+static void timer_start(void)
+{
+	// configure timer1 to 1:8 pre-scaler, SOSC clock source, 125ms ticks
+	T1CON = 0b10111111;
+	T1GCON = 0;
+	TMR1H = 0xFE;
+	TMR1L = 0x00;
+	PIR1bits.TMR1IF = 0;
+	PIE1bits.TMR1IE = 1;
+}
+
+static void wait_frame(uint8_t last_frame)
+{
+	bool remote_handled = false;
+
+	// core stops in idle mode, but peripherals (timers, RTCC, LCD, comparators) keep running
+	OSCCONbits.IDLEN = 1;
+
+	while (last_frame == ticks_frames && !power_failing() && !controls_pending())
+	{
+		// remote signals a request by HIGH on PGC, handle it right away instead of waiting for the frame end
+		if (hal_remote_clock() && !remote_handled)
+		{
+			PROFILER_BEGIN(PROFILER_REMOTE_HANDLE);
+			remote_handle();
+			PROFILER_END(PROFILER_REMOTE_HANDLE);
+			remote_handled = true;
+		}
+
+		// interrupts are disabled to not miss the wake-up between the check and SLEEP instruction,
+		// pending interrupt wakes the core anyway and it's serviced as soon as interrupts are enabled again
+		INTCONbits.GIE = 0;
+		if (last_frame == ticks_frames && !power_failing() && !controls_pending())
+		{
+			hal_sleep();
+		}
+		INTCONbits.GIE = 1;
+
+		// WDT time-out doesn't reset the core in idle mode, it just wakes it up
+		// timer interrupts are not coming for seconds, so reset it the same way as WDT would do
+		if (!RCONbits.TO)
+			hal_reset();
+	}
+}
+
+static void power_fail(void)
+{
+	// supply voltage is falling and valves are already closed by the interrupt, save what's needed to resume
+	power_emergency();
+
+	// wait in sleep until power comes back, brown-out reset comes first if it doesn't
+	sleep();
+
+	ac_sensed_frame = ticks_frames;
+	last_seconds = ticks_seconds;
 }
 
 void sleep(void)
@@ -189,8 +452,43 @@ void sleep(void)
 	// sleep enabled only in release build
 	return;
 #endif
+	sleep_state.intcon = INTCON;
 	INTCON = 0;
 
+	// valves are closed before the port state is saved, so they can't be opened by its restore
+	stations_close_all();
+
+	sleep_state.osccon = OSCCON;
+	sleep_state.osccon2 = OSCCON2;
+	sleep_state.pmd1 = PMD1;
+	sleep_state.lata = LATA;
+	sleep_state.latb = LATB;
+	sleep_state.latc = LATC;
+	sleep_state.latd = LATD;
+	sleep_state.late = LATE;
+	sleep_state.latf = LATF;
+	sleep_state.latg = LATG;
+	sleep_state.lath = LATH;
+	sleep_state.latj = LATJ;
+	sleep_state.trisa = TRISA;
+	sleep_state.trisb = TRISB;
+	sleep_state.trisc = TRISC;
+	sleep_state.trisd = TRISD;
+	sleep_state.trise = TRISE;
+	sleep_state.trisf = TRISF;
+	sleep_state.trisg = TRISG;
+	sleep_state.trish = TRISH;
+	sleep_state.trisj = TRISJ;
+	sleep_state.padcfg1 = PADCFG1;
+	sleep_state.intcon2 = INTCON2;
+	sleep_state.intcon3 = INTCON3;
+	sleep_state.pie1 = PIE1;
+	sleep_state.pie2 = PIE2;
+	sleep_state.pie3 = PIE3;
+	sleep_state.pie4 = PIE4;
+	sleep_state.pie5 = PIE5;
+	sleep_state.pie6 = PIE6;
+
 	// switch to internal oscillator, but keep RTCC SOSCGO oscillator running
 	OSCCON = 0b00110010;
 	OSCCON2 = 0b00001010;
@@ -214,6 +512,10 @@ void sleep(void)
 	T2CON = 0;
 	T3CON = 0;
 	T3GCON = 0;
+	T4CON = 0;
+	T5CON = 0;
+	T5GCON = 0;
+	T6CON = 0;
 
 	// disable reference oscillator output
 	REFOCON = 0;
@@ -297,13 +599,91 @@ void sleep(void)
 	// enable interrupt on INT1 (wake when any button is pressed)
 	INTCON3bits.INT1IE = 1;
 
-	// go to sleep and eventually wake up to reset
+	// go to sleep and eventually wake up to resume
 	OSCCONbits.IDLEN = 0;
 	NOP();
 	NOP();
-	SLEEP();
-	NOP();
+	hal_sleep();
 	NOP();
 	NOP();
-	RESET();
+
+	resume();
+}
+
+static void resume(void)
+{
+	INTCON = 0;
+	INTCON3 = 0;
+
+	// switch back to primary oscillator and wait until it's stable
+	OSCCON2 = sleep_state.osccon2;
+	OSCCON = sleep_state.osccon;
+	while (!OSCCONbits.OSTS);
+	PMD1 = sleep_state.pmd1;
+
+	// regulator voltage goes back to normal, WDT enabled
+	WDTCON = 0b10010001;
+
+	// restore ports (valves were closed before the sleep)
+	LATA = sleep_state.lata;
+	LATB = sleep_state.latb;
+	LATC = sleep_state.latc;
+	LATD = sleep_state.latd;
+	LATE = sleep_state.late;
+	LATF = sleep_state.latf;
+	LATG = sleep_state.latg;
+	LATH = sleep_state.lath;
+	LATJ = sleep_state.latj;
+
+	TRISA = sleep_state.trisa;
+	TRISB = sleep_state.trisb;
+	TRISC = sleep_state.trisc;
+	TRISD = sleep_state.trisd;
+	TRISE = sleep_state.trise;
+	TRISF = sleep_state.trisf;
+	TRISG = sleep_state.trisg;
+	TRISH = sleep_state.trish;
+	TRISJ = sleep_state.trisj;
+
+	PADCFG1 = sleep_state.padcfg1;
+
+	// restore peripherals disabled by the sleep, RAM state (including stations queue) is kept
+	stations_resume();
+	ui_resume();
+	sensor_resume();
+	profiler_resume();
+
+	// continue counting from current RTCC time instead of waiting for the next whole second,
+	// eventual sub-second phase error is fixed by the next minute alarm, time set waiting for its second is dropped
+	rtcc_set_frames = 0;
+	rtcc_set_pending = false;
+	rtcc_sync();
+	ticks_seconds = bcd_to_number(now.seconds);
+	ticks_fractions = RTCCFGbits.HALFSEC ? 4 : 0;
+	timer_start();
+
+	// drop interrupt flags raised during the sleep
+	PIR3bits.RTCCIF = 0;
+	(void)PORTB;
+	INTCONbits.RBIF = 0;
+
+	INTCON2 = sleep_state.intcon2;
+	INTCON3 = sleep_state.intcon3;
+	PIE1 = sleep_state.pie1;
+	PIE2 = sleep_state.pie2;
+	PIE3 = sleep_state.pie3;
+	PIE4 = sleep_state.pie4;
+	PIE5 = sleep_state.pie5;
+	PIE6 = sleep_state.pie6;
+
+	// controls scan is started after the interrupts restore, they might have been saved while it was parked
+	controls_resume();
+
+	// HLVD is armed again after the PIE restore, it might have been disabled by the power failure
+	power_init();
+
+	INTCON = sleep_state.intcon;
+
+	// the queue survived the sleep in RAM, the power failure record must not replay it after a later reset
+	stations_queue_discard();
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "power.h"
+#include "stations.h"
+#include "eeprom.h"
+
+power_ac_stats_t power_ac_stats;
+
+static volatile bool ac_present = false;
+static volatile bool ac_synced = false;
+
+// running sum of last 8 mains periods
+static volatile uint16_t ac_period_sum = AC_NOMINAL_PERIOD * 8;
+
+// value timer5 was restarted from on the last edge
+static volatile uint16_t ac_timer_start = 0;
+
+// edges left in the current sample, INT0 is disabled after the last one, 0 while the mains is followed continuously
+static volatile uint8_t ac_sample_edges = 0;
+
+static volatile bool voltage_low = false;
+
+static void timeout_start(void)
+{
+	// restart the timer to overflow when no edge comes in next 2.5 periods
+	uint16_t average = ac_period_sum >> 3;
+	ac_timer_start = 0 - (uint16_t)(average * 2 + (average >> 1));
+	TMR5H = ac_timer_start >> 8;
+	TMR5L = ac_timer_start & 255;
+	PIR5bits.TMR5IF = 0;
+	T5CONbits.TMR5ON = 1;
+}
+
+static void sense_start(void)
+{
+	// timer5 was stopped since the last sample, the period is measured from the first edge again,
+	// but the timeout runs from now, so the sample ends even if no edge comes
+	ac_synced = false;
+	timeout_start();
+	INTCONbits.INT0IF = 0;
+	INTCONbits.INT0IE = 1;
+}
+
+void power_init(void)
+{
+	ac_present = false;
+	ac_synced = false;
+	ac_sample_edges = 0;
+
+	// HLVD interrupt when the supply voltage falls below the trip point
+	PIE2bits.HLVDIE = 0;
+	HLVDCON = 0b00010000 | HLVD_TRIP_POINT;
+	while (!hal_hlvd_stable());
+
+	// sagging supply would trip it again right away, so the flag has to stay clear for the whole settle time
+	for (uint8_t stable = 0; stable < HLVD_SETTLE_TIME / 10; )
+	{
+		CLRWDT();
+		PIR2bits.HLVDIF = 0;
+		hal_delay_ms(10);
+		stable = PIR2bits.HLVDIF ? 0 : stable + 1;
+	}
+
+	voltage_low = false;
+	eeprom_write_abort = false;
+	PIR2bits.HLVDIF = 0;
+	PIE2bits.HLVDIE = 1;
+
+	// Fosc/4 clock source, 1:8 pre-scaler, 16-bit read/write, stopped until the first edge comes
+	T5CON = 0b00110010;
+	T5GCON = 0;
+	PIR5bits.TMR5IF = 0;
+	PIE5bits.TMR5IE = 1;
+
+	// INT0 on falling edge to sense AC
+	INTCON2bits.INTEDG0 = 0;
+	INTCONbits.INT0IF = 0;
+	INTCONbits.INT0IE = 1;
+}
+
+void power_ac_edge(void)
+{
+	// measure time elapsed since the previous edge
+	uint8_t low = TMR5L;
+	uint16_t period = (((uint16_t)TMR5H << 8) | low) - ac_timer_start;
+	uint16_t average = ac_period_sum >> 3;
+
+	if (ac_synced)
+	{
+		if (period < (average >> 1))
+			// too short period means a glitch, not a mains edge
+			return;
+
+		if (period > average + (average >> 1))
+			// at least a single cycle is missing
+			power_ac_stats.missing_cycles++;
+		else
+			ac_period_sum = ac_period_sum - average + period;
+	}
+
+	power_ac_stats.edges++;
+
+	ac_present = true;
+	ac_synced = true;
+
+	timeout_start();
+
+	if (ac_sample_edges && --ac_sample_edges == 0)
+	{
+		// sample is complete, mains is considered present till the next one
+		INTCONbits.INT0IE = 0;
+		T5CONbits.TMR5ON = 0;
+	}
+}
+
+void power_ac_timeout(void)
+{
+	// no edge came in time, mains is gone
+	T5CONbits.TMR5ON = 0;
+
+	if (ac_present)
+	{
+		power_ac_stats.dropouts++;
+
+		// close valves right now while there's still some energy, don't wait for the main loop
+		stations_power_lost();
+	}
+
+	ac_present = false;
+	ac_synced = false;
+}
+
+void power_ac_resync(void)
+{
+	// edges were masked for a while, the next one starts the period measurement again instead of counting missed cycles
+	ac_synced = false;
+}
+
+void power_ac_sample(void)
+{
+	// edges wake the core 100 times a second, so without open valves the mains is sensed only by a few of them
+	if (INTCONbits.INT0IE)
+	{
+		// mains followed continuously or missing, the next edges end it
+		if (ac_sample_edges == 0)
+			ac_sample_edges = AC_SAMPLE_EDGES;
+		return;
+	}
+
+	ac_sample_edges = AC_SAMPLE_EDGES;
+	sense_start();
+}
+
+void power_ac_follow(void)
+{
+	// open valves are closed right on a dropout, it's detected within 2.5 periods only if every edge is sensed
+	ac_sample_edges = 0;
+	if (!INTCONbits.INT0IE)
+		sense_start();
+}
+
+bool power_ac_present(void)
+{
+	return ac_present;
+}
+
+void power_voltage_low(void)
+{
+	// it's handled only once, HLVD is armed again by the next init
+	PIE2bits.HLVDIE = 0;
+
+	// close valves to cut the biggest load, and stop EEPROM writes that wouldn't finish
+	stations_power_lost();
+	eeprom_write_abort = true;
+	voltage_low = true;
+}
+
+bool power_failing(void)
+{
+	return voltage_low;
+}
+
+void power_emergency(void)
+{
+	voltage_low = false;
+
+	stations_queue_pause();
+
+	// interrupted write left its EEPROM slot invalid, now use the remaining energy for the queue record only
+	eeprom_write_abort = false;
+	stations_queue_save();
+}
+
+uint16_t power_ac_frequency(void)
+{
+	if (!ac_present)
+		return 0;
+
+	// edges frequency in 0.1Hz units
+	return (uint16_t)((AC_TIMER_FREQUENCY * 10UL) / (ac_period_sum >> 3));
+}
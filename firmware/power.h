@@ -0,0 +1,59 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "types.h"
+
+// timer5 runs from Fosc/4 with 1:8 pre-scaler, so it ticks every 8us
+#define AC_TIMER_FREQUENCY (_XTAL_FREQ / 4 / 8)
+
+// period of 50Hz mains in timer ticks, used until the real period is measured
+#define AC_NOMINAL_PERIOD (AC_TIMER_FREQUENCY / 50)
+
+// mains edges sensed every second while no valve is open, the second one measures a period
+#define AC_SAMPLE_EDGES 2
+
+// frames without mains before the unit goes to sleep, counted by the frame ticks as the frames may come in batches
+#define AC_SENSE_TIMEOUT 40
+
+// HLVD trip point 2.79V-2.98V, well above the brown-out reset, so there's time to close valves and save the queue
+#define HLVD_TRIP_POINT 0b0110
+
+// supply has to stay above the trip point this long before HLVD is armed, in 10ms steps
+#define HLVD_SETTLE_TIME 100 // ms
+
+typedef struct
+{
+	uint16_t edges;
+	uint16_t missing_cycles;
+	uint16_t dropouts;
+} power_ac_stats_t;
+
+extern power_ac_stats_t power_ac_stats;
+
+void power_init(void);
+void power_ac_edge(void);
+void power_ac_timeout(void);
+void power_ac_resync(void);
+void power_ac_sample(void);
+void power_ac_follow(void);
+bool power_ac_present(void);
+uint16_t power_ac_frequency(void);
+
+void power_voltage_low(void);
+bool power_failing(void);
+void power_emergency(void);
@@ -0,0 +1,78 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+profiler_stats_t profiler_stats;
+
+void profiler_init(void)
+{
+	profiler_resume();
+	profiler_reset();
+}
+
+void profiler_resume(void)
+{
+	// configure timer3 to instruction clock, 1:8 pre-scaler, 16-bit reads
+	// it's disabled by sleep, statistics are kept
+	T3CON = 0b00110011;
+	T3GCON = 0;
+}
+
+void profiler_reset(void)
+{
+	for (uint8_t n = 0; n < PROFILER_REGIONS; ++n)
+	{
+		profiler_region_stats_t* stats = &profiler_stats.regions[n];
+		stats->count = 0;
+		stats->min = UINT16_MAX;
+		stats->max = 0;
+		stats->total = 0;
+	}
+
+	profiler_stats.frame_overruns = 0;
+}
+
+uint16_t profiler_time(void)
+{
+	// high byte is latched by the low byte read
+	uint8_t low = TMR3L;
+	return ((uint16_t)TMR3H << 8) | low;
+}
+
+void profiler_end(uint8_t region, uint16_t start)
+{
+	uint16_t time = profiler_time() - start;
+
+	profiler_region_stats_t* stats = &profiler_stats.regions[region];
+	if (stats->count < UINT16_MAX)
+	{
+		// count and total stop together, so the average stays valid
+		stats->count++;
+		stats->total += time;
+	}
+	if (time < stats->min)
+		stats->min = time;
+	if (time > stats->max)
+		stats->max = time;
+
+	if (region == PROFILER_FRAME && time > PROFILER_FRAME_TICKS && profiler_stats.frame_overruns < UINT16_MAX)
+		profiler_stats.frame_overruns++;
+}
+
+#endif
@@ -0,0 +1,82 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "types.h"
+
+// profiler of the main loop regions, timestamps are taken from timer3 counting instruction cycles
+// it's always built in debug configuration, release configuration needs PROFILER macro defined
+
+#if !defined(RELEASE) || defined(PROFILER)
+#define PROFILER_ENABLED
+#endif
+
+// timer3 pre-scaler, 65536 ticks cover 524ms
+#define PROFILER_TICK_CYCLES 8
+
+// frame period in timer3 ticks
+#define PROFILER_FRAME_TICKS (_XTAL_FREQ / 4 / 8 / PROFILER_TICK_CYCLES)
+
+enum profiler_region_t
+{
+	PROFILER_FRAME,
+	PROFILER_REMOTE_HANDLE,
+	PROFILER_PROGRAMS_SAVE,
+	PROFILER_SENSOR_UPDATE,
+	PROFILER_DISPLAY_UPDATE,
+	PROFILER_REGIONS
+};
+
+typedef struct
+{
+	// durations are in timer3 ticks
+	uint16_t count;
+	uint16_t min;
+	uint16_t max;
+	uint32_t total;
+} profiler_region_stats_t;
+
+typedef struct
+{
+	profiler_region_stats_t regions[PROFILER_REGIONS];
+	uint16_t frame_overruns; // frames which work took longer than the frame period
+} profiler_stats_t;
+
+#ifdef PROFILER_ENABLED
+
+extern profiler_stats_t profiler_stats;
+
+void profiler_init(void);
+void profiler_resume(void);
+void profiler_reset(void);
+uint16_t profiler_time(void);
+void profiler_end(uint8_t region, uint16_t start);
+
+// begin and end of a region have to be in the same block
+#define PROFILER_BEGIN(region) uint16_t profiler_start_##region = profiler_time()
+#define PROFILER_END(region) profiler_end(region, profiler_start_##region)
+
+#else
+
+#define profiler_init() ((void)0)
+#define profiler_resume() ((void)0)
+#define profiler_reset() ((void)0)
+
+#define PROFILER_BEGIN(region) ((void)0)
+#define PROFILER_END(region) ((void)0)
+
+#endif
@@ -16,21 +16,88 @@
 
 #include "programs.h"
 #include "eeprom.h"
+#include "rtcc.h"
+#include "calendar.h"
+#include "profiler.h"
 
 program_t programs[NUMBER_OF_PROGRAMS];
 uint8_t programs_seasonal_adjustment;
 
+// slot and sequence number of the last saved image
+static uint8_t programs_slot = 0;
+static uint8_t programs_sequence = 0;
+
+static uint16_t slot_offset(uint8_t slot)
+{
+	return slot ? PROGRAMS_SLOT_1 : PROGRAMS_SLOT_0;
+}
+
+static uint8_t checksum_update(uint8_t checksum, const uint8_t* ptr, uint8_t size)
+{
+	for (uint8_t n = 0; n < size; ++n)
+		checksum += ptr[n];
+	return checksum;
+}
+
+static bool slot_check(uint8_t slot, uint8_t* sequence)
+{
+	uint16_t offset = slot_offset(slot);
+	uint8_t size = sizeof(programs) + sizeof(programs_seasonal_adjustment);
+
+	// checksum covers the image and its sequence number, it's stored inverted so the erased slot isn't valid
+	uint8_t checksum = 0;
+	for (uint8_t n = 0; n <= size; ++n)
+		checksum += eeprom_read_byte(offset + n);
+
+	*sequence = eeprom_read_byte(offset + size);
+	return (eeprom_read_byte(offset + size + 1) == (uint8_t)~checksum);
+}
+
+static void migrate_offsets(void)
+{
+	// older firmware counted interval offsets from its year day, they're moved so the programs water on the same days
+	datetime_t time;
+	rtcc_get(&time);
+	uint8_t year = bcd_to_number(time.year);
+	uint8_t month = bcd_to_number(time.month);
+	uint8_t day = bcd_to_number(time.day);
+
+	for (uint8_t n = 0; n < NUMBER_OF_PROGRAMS; ++n)
+	{
+		program_calendar_t* calendar = &programs[n].calendar;
+		if (calendar->repeat_bits == 0b10)
+			calendar->offset = calendar_migrate_offset(calendar->offset, calendar->days, year, month, day);
+	}
+}
+
 void programs_init(void)
 {
-	if (!eeprom_check())
+	if (eeprom_check(EEPROM_LAYOUT) && programs_restore())
+		return;
+
+	if (eeprom_check(EEPROM_LAYOUT_YEAR_DAY) && programs_restore())
 	{
-		programs_defaults();
+		// the migrated image goes to the other slot, a power loss before the marker is written would migrate it twice
+		migrate_offsets();
 		programs_save();
 		eeprom_validate();
 		return;
 	}
 
-	programs_restore();
+	if (eeprom_check(EEPROM_LAYOUT_LEGACY))
+	{
+		// image saved by older firmware, it's stored at the first slot offset without sequence and checksum
+		eeprom_read_data((uint8_t*)&programs, sizeof(programs), PROGRAMS_SLOT_0);
+		eeprom_read_data((uint8_t*)&programs_seasonal_adjustment, sizeof(programs_seasonal_adjustment), PROGRAMS_SLOT_0 + sizeof(programs));
+		migrate_offsets();
+	}
+	else
+		programs_defaults();
+
+	// the second slot is written first, so the legacy image is kept until the new layout is valid
+	programs_save();
+	eeprom_validate();
+	programs_save();
 }
 
 void programs_defaults(void)
@@ -51,46 +118,96 @@ void programs_defaults(void)
 	programs_seasonal_adjustment = 10;
 }
 
-void programs_restore(void)
+bool programs_restore(void)
 {
-	eeprom_read_data((uint8_t*)&programs, sizeof(programs), 0x0010);
-	eeprom_read_data((uint8_t*)&programs_seasonal_adjustment, sizeof(programs_seasonal_adjustment), 0x0010 + sizeof(programs));
+	uint8_t sequence_0, sequence_1;
+	bool valid_0 = slot_check(0, &sequence_0);
+	bool valid_1 = slot_check(1, &sequence_1);
+
+	if (valid_0 && valid_1)
+		// both images are valid, take the newer one
+		programs_slot = ((int8_t)(sequence_1 - sequence_0) > 0) ? 1 : 0;
+	else if (valid_0 || valid_1)
+		// the other image was torn by a power loss during its write
+		programs_slot = valid_1 ? 1 : 0;
+	else
+		return false;
+
+	programs_sequence = programs_slot ? sequence_1 : sequence_0;
+
+	uint16_t offset = slot_offset(programs_slot);
+	eeprom_read_data((uint8_t*)&programs, sizeof(programs), offset);
+	eeprom_read_data((uint8_t*)&programs_seasonal_adjustment, sizeof(programs_seasonal_adjustment), offset + sizeof(programs));
+	return true;
+}
+
+static void slot_write(void)
+{
+	// write to the other slot than the last image is in, so it's kept intact if this write is interrupted
+	uint8_t slot = programs_slot ^ 1;
+	uint8_t sequence = programs_sequence + 1;
+	uint16_t offset = slot_offset(slot);
+
+	uint8_t checksum = checksum_update(0, (const uint8_t*)&programs, sizeof(programs));
+	checksum = checksum_update(checksum, &programs_seasonal_adjustment, sizeof(programs_seasonal_adjustment));
+	checksum += sequence;
+	checksum = ~checksum;
+
+	// any failed write means the power is failing, the slot stays invalid and the previous one is used
+	if (!eeprom_write_data((const uint8_t*)&programs, sizeof(programs), offset))
+		return;
+	offset += sizeof(programs);
+	if (!eeprom_write_data(&programs_seasonal_adjustment, sizeof(programs_seasonal_adjustment), offset))
+		return;
+	offset += sizeof(programs_seasonal_adjustment);
+	if (!eeprom_write_byte(offset, sequence))
+		return;
+	if (!eeprom_write_byte(offset + 1, checksum))
+		return;
+
+	programs_slot = slot;
+	programs_sequence = sequence;
 }
 
 void programs_save(void)
 {
-	eeprom_write_data((uint8_t*)&programs, sizeof(programs), 0x0010);
-	eeprom_write_data((uint8_t*)&programs_seasonal_adjustment, sizeof(programs_seasonal_adjustment), 0x0010 + sizeof(programs));
+	PROFILER_BEGIN(PROFILER_PROGRAMS_SAVE);
+	slot_write();
+	PROFILER_END(PROFILER_PROGRAMS_SAVE);
 }
 
-void programs_check(const datetime_t* now)
+uint16_t programs_start_minute(const program_start_time_t* start_time)
 {
-	uint16_t year_day = rtcc_year_day(now);
+	// OFF (hour 0x24) is out of the day range, so it never matches
+	return bcd_to_number(start_time->hour) * 60 + bcd_to_number(start_time->minute);
+}
 
+void programs_check(const timestamp_t* time)
+{
 	const program_t* program = &programs[0];
 	for (uint8_t n = 0; n < NUMBER_OF_PROGRAMS; ++n, ++program)
 	{
-		program_start_time_t start_time = program->start_time;
 		program_calendar_t calendar = program->calendar;
 
-		if (!(start_time.hour == now->hours && start_time.minute == now->minutes))
+		if (programs_start_minute(&program->start_time) != time->minute_of_day)
 			continue;
 
 		if (calendar.weekdays_bit == 0)
 		{
-			if (!(calendar.weekdays_mask & (1 << now->weekday)))
+			if (!(calendar.weekdays_mask & (1 << time->weekday)))
 				// program not enabled for current weekday
 				continue;
 		}
 		else if (calendar.repeat_bits == 0b10)
 		{
-			if (calendar.offset != (year_day % (calendar.days + 1)))
+			// continuous day count keeps the interval in phase across the new year
+			if (calendar.offset != (time->epoch_day % (calendar.days + 1)))
 				// program not enabled for current n-th day
 				continue;
 		}
 		else if (calendar.odd_even_bits == 0b110)
 		{
-			if (calendar.odd_even == (year_day & 1))
+			if (calendar.odd_even == (time->year_day & 1))
 				// program not enabled for current odd/even day
 				continue;
 		}
@@ -117,15 +234,13 @@ bool programs_queue(const program_t* program)
 	return any_started;
 }
 
-void programs_reset_calendar(const datetime_t* now)
+void programs_reset_calendar(const timestamp_t* time)
 {
-	uint16_t year_day = rtcc_year_day(now);
-
 	for (uint8_t n = 0; n < NUMBER_OF_PROGRAMS; ++n)
 	{
 		// reset calendar offset to this n-day
 		if (programs[n].calendar.repeat_bits == 0b10)
-			programs[n].calendar.offset = year_day % (programs[n].calendar.days + 1);
+			programs[n].calendar.offset = time->epoch_day % (programs[n].calendar.days + 1);
 	}
 
 	programs_save();
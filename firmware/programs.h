@@ -22,6 +22,10 @@
 
 #define NUMBER_OF_PROGRAMS 8
 
+// programs image is saved alternately to two EEPROM slots, each followed by sequence number and checksum
+#define PROGRAMS_SLOT_0		0x0010
+#define PROGRAMS_SLOT_1		0x0080
+
 typedef struct
 {
 	uint8_t hour; // 0x24 means OFF
@@ -66,9 +70,10 @@ extern uint8_t programs_seasonal_adjustment;
 
 void programs_init(void);
 void programs_defaults(void);
-void programs_restore(void);
+bool programs_restore(void);
 void programs_save(void);
 
-void programs_check(const datetime_t* now);
+uint16_t programs_start_minute(const program_start_time_t* start_time);
+void programs_check(const timestamp_t* time);
 bool programs_queue(const program_t* program);
-void programs_reset_calendar(const datetime_t* now);
+void programs_reset_calendar(const timestamp_t* time);
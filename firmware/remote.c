@@ -20,9 +20,20 @@
 #include "controls.h"
 #include "ui.h"
 #include "rtcc.h"
+#include "scheduler.h"
+#include "power.h"
+#include "benchmark.h"
+#include "profiler.h"
+
+extern volatile uint8_t ticks_seconds;
+extern volatile uint8_t ticks_fractions;
 
 static uint8_t packet[32];
 
+#ifdef HOST
+remote_stats_t remote_stats;
+#endif
+
 static uint8_t crc_update(uint8_t crc, uint8_t data)
 {
 	data ^= crc;
@@ -48,35 +59,56 @@ static uint8_t crc_update(uint8_t crc, uint8_t data)
 	return crc;
 }
 
-static bool wait_clock(uint8_t prescaler, uint8_t ticks, bool state)
+// interrupt enables kept during the link transfer
+static bool link_controls = false;
+static bool link_ac = false;
+static bool link_ac_timeout = false;
+static bool link_sensor = false;
+
+static void link_begin(void)
 {
-	// wait for clock pulse flips to state, no longer than 200us
-	T0CON = 0b11000000 + prescaler;
-	TMR0L = 255 - ticks + 1;
-	INTCONbits.T0IF = 0;
-	while (!INTCONbits.T0IF && PORTBbits.PGC != state);
-	return !INTCONbits.T0IF;
+	// remote holds a bit only 50us, XC8 context save alone takes ~30us at 1 MIPS, so the controls scan, mains edge and
+	// sensor handlers would make the bits missed, they are postponed till the transfer ends (frame tick stays, it's 8Hz)
+	link_controls = PIE5bits.TMR4IE;
+	link_ac = INTCONbits.INT0IE;
+	link_ac_timeout = PIE5bits.TMR5IE;
+	link_sensor = PIE5bits.TMR6IE;
+
+	PIE5bits.TMR4IE = 0;
+	INTCONbits.INT0IE = 0;
+	PIE5bits.TMR5IE = 0;
+	PIE5bits.TMR6IE = 0;
 }
 
-static uint8_t receive_packet(void)
+static void link_end(void)
 {
-	// remote input is signaled by HIGH on PGC
-	if (!PORTBbits.PGC)
-		return 0;
+	power_ac_resync();
+
+	// pending flags are served right away, an edge is handled before the timeout
+	PIE5bits.TMR6IE = link_sensor;
+	PIE5bits.TMR5IE = link_ac_timeout;
+	INTCONbits.INT0IE = link_ac;
+	PIE5bits.TMR4IE = link_controls;
+}
 
+static uint8_t read_packet(void)
+{
 	// signal remote on PGD to send its accept signal
-	TRISBbits.TRISB7 = 0;
-	PORTBbits.PGD = 1;
+	hal_remote_data_output(true);
+	hal_remote_set_data(1);
 	// wait for remote to accept signal by setting PGC to LOW, no longer than 5ms
-	bool timed_out = !wait_clock(7, 20, false);
+	bool timed_out = !hal_remote_wait_clock(7, 20, false);
 
 	// switch PGD back to input
-	PORTBbits.PGD = 0;
-	TRISBbits.TRISB7 = 1;
+	hal_remote_set_data(0);
+	hal_remote_data_output(false);
 
 	if (timed_out)
+	{
 		// wait for accept signal timed out
+		REMOTE_STATS_COUNT(accept_timeouts);
 		return 0;
+	}
 
 	// read data from PGD, single bit a PGC pulse
 	uint8_t packet_len = 0;
@@ -88,36 +120,50 @@ static uint8_t receive_packet(void)
 		for (uint8_t bits = 0; bits < 8; ++bits, mask <<= 1)
 		{
 			// wait for clock pulse flips to HIGH, no longer than 200us
-			if (!wait_clock(0, 100, true))
+			if (!hal_remote_wait_clock(0, 100, true))
 			{
 				if (bits > 0)
+				{
 					// no clock in middle of byte means error
+					REMOTE_STATS_COUNT(bit_timeouts);
 					return 0;
+				}
 
 				// no clock after entire byte means end of packet
 
 				if (packet_len < 2)
+				{
 					// packet must contain at least single byte payload followed by 8bit CRC
+					REMOTE_STATS_COUNT(length_errors);
 					return 0;
+				}
 
 				// check packet CRC
 				uint8_t crc = 0;
 				for (uint8_t n = 0; n < packet_len - 1; ++n)
 					crc = crc_update(crc, packet[n]);
 				if (packet[packet_len - 1] != crc)
+				{
 					// packet CRC mismatch!
+					REMOTE_STATS_COUNT(crc_errors);
 					return 0;
+				}
+
+				REMOTE_STATS_COUNT(received);
 
 				// return size of payload without CRC at the end
 				return packet_len - 1;
 			}
 
-			if (PORTBbits.PGD)
+			if (hal_remote_data())
 				packet[bytes] |= mask;
 
 			// wait for clock pulse flips to LOW, no longer than 200us
-			if (!wait_clock(0, 100, false))
+			if (!hal_remote_wait_clock(0, 100, false))
+			{
+				REMOTE_STATS_COUNT(bit_timeouts);
 				return 0;
+			}
 		}
 
 		if (packet_len++ == UINT8_MAX)
@@ -125,22 +171,36 @@ static uint8_t receive_packet(void)
 	}
 
 	// packet is too long
+	REMOTE_STATS_COUNT(length_errors);
 	return 0;
 }
 
+static uint8_t receive_packet(void)
+{
+	// remote input is signaled by HIGH on PGC
+	if (!hal_remote_clock())
+		return 0;
+
+	link_begin();
+	uint8_t packet_len = read_packet();
+	link_end();
+
+	return packet_len;
+}
+
 static bool send_byte(uint8_t data)
 {
 	uint8_t mask = 1;
 	for (uint8_t bits = 0; bits < 8; ++bits, mask <<= 1)
 	{
-		PORTBbits.PGD = (data & mask) ? 1 : 0;
+		hal_remote_set_data((data & mask) ? 1 : 0);
 
 		// wait for clock pulse flips to HIGH, no longer than 200us
-		if (!wait_clock(0, 100, true))
+		if (!hal_remote_wait_clock(0, 100, true))
 			return false;
 
 		// wait for clock pulse flips to LOW, no longer than 200us
-		if (!wait_clock(0, 100, false))
+		if (!hal_remote_wait_clock(0, 100, false))
 			return false;
 	}
 
@@ -150,18 +210,18 @@ static bool send_byte(uint8_t data)
 static void send_start()
 {
 	// signal the remote that some data are going to be sent
-	TRISBbits.TRISB7 = 0;
-	PORTBbits.PGD = 1;
+	hal_remote_data_output(true);
+	hal_remote_set_data(1);
 }
 
 static void send_finish()
 {
 	// switch PGD back to input
-	PORTBbits.PGD = 0;
-	TRISBbits.TRISB7 = 1;
+	hal_remote_set_data(0);
+	hal_remote_data_output(false);
 }
 
-static bool send_packet(const uint8_t* data, size_t length)
+static bool transfer_packet(const uint8_t* data, size_t length)
 {
 	if (length > UINT8_MAX)
 		return false;
@@ -174,16 +234,16 @@ static bool send_packet(const uint8_t* data, size_t length)
 	// PGD should be already set to HIGH to signal remote that some data are going to be sent
 
 	// remote accepts it by setting PGC to HIGH, wait no longer than 5ms
-	bool timed_out = !wait_clock(7, 20, true);
+	bool timed_out = !hal_remote_wait_clock(7, 20, true);
 
-	PORTBbits.PGD = 0;
+	hal_remote_set_data(0);
 
 	if (timed_out)
 		// wait for accept signal timed out
 		return false;
 
 	// wait for PGC pulse to going LOW before sending the data, no longer than 5ms
-	if (!wait_clock(7, 20, false))
+	if (!hal_remote_wait_clock(7, 20, false))
 		return false;
 
 	// write data to PGD, single bit a PGC pulse
@@ -200,18 +260,37 @@ static bool send_packet(const uint8_t* data, size_t length)
 	return true;
 }
 
+static bool send_packet(const uint8_t* data, size_t length)
+{
+	link_begin();
+	bool transferred = transfer_packet(data, length);
+	link_end();
+
+	if (!transferred)
+	{
+		// remote didn't accept the packet or stopped clocking it
+		REMOTE_STATS_COUNT(send_timeouts);
+		return false;
+	}
+
+	REMOTE_STATS_COUNT(sent);
+	return true;
+}
+
 void remote_init(void)
 {
 	// PGC/RB6 clock input
 	TRISBbits.TRISB6 = 1;
 
 	// PGD/RB7 data input/output (input initially)
-	TRISBbits.TRISB7 = 1;
+	hal_remote_data_output(false);
 }
 
 void remote_handle(void)
 {
+	BENCHMARK_BEGIN(BENCHMARK_RECEIVE_PACKET);
 	uint8_t packet_len = receive_packet();
+	BENCHMARK_END(BENCHMARK_RECEIVE_PACKET);
 	if (packet_len == 0)
 		// no valid packet received
 		return;
@@ -259,6 +338,7 @@ void remote_handle(void)
 
 			programs_seasonal_adjustment = packet[1];
 			programs_save();
+			ui_refresh();
 			break;
 		}
 
@@ -277,6 +357,42 @@ void remote_handle(void)
 			rtcc_fix(&now);
 			rtcc_set(&now, true);
 			rtcc_sync();
+			ui_refresh();
+			break;
+		}
+
+		case 0xA5:
+		{
+			// set precise date/time, it's applied when the given whole second starts (delay in ms after the packet end)
+			if (packet_len != 9 || packet[6] > 59)
+				return;
+
+			uint16_t delay = packet[7] | (packet[8] << 8);
+			if (delay > 1000)
+				return;
+
+			// current time is kept until the set is written
+			datetime_t time;
+			time.year = number_to_bcd(packet[1]);
+			time.month = number_to_bcd(packet[2]);
+			time.day = number_to_bcd(packet[3]);
+			time.hours = number_to_bcd(packet[4]);
+			time.minutes = number_to_bcd(packet[5]);
+			time.seconds = number_to_bcd(packet[6]);
+			rtcc_fix(&time);
+
+			// timer1 interrupt writes it and starts the fractions in the same phase, the frame loop goes on meanwhile
+			rtcc_set_at(&time, delay);
+			break;
+		}
+
+		case 0xA6:
+		{
+			// set RTCC calibration, each step adds (or removes if negative) 4 RTCC clock pulses every minute
+			if (packet_len != 2)
+				return;
+
+			rtcc_calibrate((int8_t)packet[1]);
 			break;
 		}
 
@@ -285,7 +401,7 @@ void remote_handle(void)
 			// prepare reset
 			// close all stations and wait a second for external reset to ensure it is safe (i.e. no EEPROM write is performed)
 			stations_close_all();
-			__delay_ms(1000);
+			hal_delay_ms(1000);
 		}
 
 		case 0xB1:
@@ -308,14 +424,20 @@ void remote_handle(void)
 				} datetime;
 				uint8_t seasonal_adjustment;
 				uint16_t stations[NUMBER_OF_STATIONS];
+				struct
+				{
+					uint16_t frequency;
+					uint16_t missing_cycles;
+					uint16_t dropouts;
+				} mains;
 			}
 			packet;
 
-			packet.datetime.day = bcd_to_number(now.day);
-			packet.datetime.month = bcd_to_number(now.month);
-			packet.datetime.year = bcd_to_number(now.year);
-			packet.datetime.hours = bcd_to_number(now.hours);
-			packet.datetime.minutes = bcd_to_number(now.minutes);
+			packet.datetime.day = now_binary.day;
+			packet.datetime.month = now_binary.month;
+			packet.datetime.year = now_binary.year;
+			packet.datetime.hours = now_binary.hours;
+			packet.datetime.minutes = now_binary.minutes;
 
 			packet.seasonal_adjustment = programs_seasonal_adjustment;
 
@@ -323,9 +445,153 @@ void remote_handle(void)
 			for (uint8_t n = 0; n < NUMBER_OF_STATIONS; ++n)
 				packet.stations[n] = stations_states[n].run_time;
 
+			packet.mains.frequency = power_ac_frequency();
+			packet.mains.missing_cycles = power_ac_stats.missing_cycles;
+			packet.mains.dropouts = power_ac_stats.dropouts;
+
 			// send the data packet
 			send_packet((const uint8_t*)&packet, sizeof(packet));
 			send_finish();
+			break;
+		}
+
+		case 0xB2:
+		{
+			// get scheduler statistics
+			send_start();
+
+			struct
+			{
+				uint16_t frame_time_max;
+				uint8_t frame_overruns;
+				struct
+				{
+					uint8_t late_max;
+					uint8_t overruns;
+				} tasks[SCHEDULER_TASKS];
+			}
+			packet;
+
+			packet.frame_time_max = scheduler_stats.frame_time_max;
+			packet.frame_overruns = scheduler_stats.frame_overruns;
+
+			for (uint8_t n = 0; n < SCHEDULER_TASKS; ++n)
+			{
+				packet.tasks[n].late_max = scheduler_tasks[n].late_max;
+				packet.tasks[n].overruns = scheduler_tasks[n].overruns;
+			}
+
+			send_packet((const uint8_t*)&packet, sizeof(packet));
+			send_finish();
+			break;
+		}
+
+		case 0xB3:
+		{
+			// get precise time
+			send_start();
+
+			struct
+			{
+				uint8_t year;
+				uint8_t month;
+				uint8_t day;
+				uint8_t hours;
+				uint8_t minutes;
+				uint8_t seconds;
+				uint16_t milliseconds;
+				int8_t calibration;
+			}
+			packet;
+
+			// RTCC time and phase of the fractions timer must be taken together
+			datetime_t time;
+			INTCONbits.GIE = 0;
+			rtcc_get(&time);
+			uint8_t timer_low = TMR1L;
+			uint16_t timer = (uint16_t)(TMR1H << 8) | timer_low;
+			uint8_t seconds = ticks_seconds;
+			uint8_t fractions = ticks_fractions & 7;
+			bool timer_overflow = PIR1bits.TMR1IF;
+			INTCONbits.GIE = 1;
+
+			packet.year = bcd_to_number(time.year);
+			packet.month = bcd_to_number(time.month);
+			packet.day = bcd_to_number(time.day);
+			packet.hours = bcd_to_number(time.hours);
+			packet.minutes = bcd_to_number(time.minutes);
+			packet.seconds = bcd_to_number(time.seconds);
+
+			// fractions timer counts 512 ticks every 125ms, phase isn't known if the second just changed
+			packet.milliseconds = 0;
+			if (seconds == packet.seconds && !timer_overflow)
+				packet.milliseconds = fractions * 125 + (uint16_t)((uint32_t)(timer - 0xFE00) * 125 / 512);
+
+			packet.calibration = rtcc_calibration();
+
+			send_packet((const uint8_t*)&packet, sizeof(packet));
+			send_finish();
+			break;
+		}
+
+#ifdef PROFILER_ENABLED
+		case 0xB4:
+		{
+			// get profiler statistics, optional argument 1 resets them after they are sent
+			if (packet_len > 2)
+				return;
+
+			bool reset = (packet_len == 2 && packet[1] == 1);
+
+			send_start();
+
+			struct
+			{
+				uint8_t tick_cycles;
+				profiler_stats_t stats;
+			}
+			packet;
+
+			packet.tick_cycles = PROFILER_TICK_CYCLES;
+			packet.stats = profiler_stats;
+
+			bool sent = send_packet((const uint8_t*)&packet, sizeof(packet));
+			send_finish();
+
+			if (sent && reset)
+				profiler_reset();
+			break;
+		}
+#endif
+
+		case 0xB5:
+		{
+			// get program
+			if (packet_len != 2 || packet[1] >= NUMBER_OF_PROGRAMS)
+				return;
+
+			const program_t* program = &programs[packet[1]];
+
+			send_start();
+
+			struct
+			{
+				uint8_t hour; // 24 means OFF
+				uint8_t minute;
+				program_calendar_t calendar;
+				uint8_t run_times[NUMBER_OF_STATIONS];
+			}
+			packet;
+
+			packet.hour = bcd_to_number(program->start_time.hour);
+			packet.minute = bcd_to_number(program->start_time.minute);
+			packet.calendar = program->calendar;
+			for (uint8_t n = 0; n < NUMBER_OF_STATIONS; ++n)
+				packet.run_times[n] = program->run_times[n];
+
+			send_packet((const uint8_t*)&packet, sizeof(packet));
+			send_finish();
+			break;
 		}
 	}
 }
\ No newline at end of file
@@ -18,5 +18,30 @@
 
 #include "types.h"
 
+// link counters are kept for the host link bench only, nothing reads them on the unit
+
+#ifdef HOST
+
+typedef struct
+{
+	uint16_t received; // valid packets
+	uint16_t accept_timeouts; // remote didn't accept the signal to start the transfer
+	uint16_t bit_timeouts; // clock edge missing in the middle of a byte
+	uint16_t crc_errors;
+	uint16_t length_errors; // packet without payload or longer than the buffer
+	uint16_t sent;
+	uint16_t send_timeouts;
+} remote_stats_t;
+
+extern remote_stats_t remote_stats;
+
+#define REMOTE_STATS_COUNT(counter) (remote_stats.counter++)
+
+#else
+
+#define REMOTE_STATS_COUNT(counter) ((void)0)
+
+#endif
+
 void remote_init(void);
 void remote_handle(void);
\ No newline at end of file
@@ -15,16 +15,25 @@
 */
 
 #include "rtcc.h"
+#include "calendar.h"
+#include "eeprom.h"
 
 datetime_t now;
-
-// month days
-static const uint8_t month_days_table[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
-// first week-day for years 2000-27, then it repeats
-static const uint8_t first_weekday_table[28] = { 5, 0, 1, 2, 3, 5, 6, 0, 1, 3, 4, 5, 6, 1, 2, 3, 4, 6, 0, 1, 2, 4, 5, 6, 0, 2, 3, 4 };
+timestamp_t now_binary;
 
 static const datetime_t default_datetime = { 0x21, 0x01, 0x01, 0x04, 0x12, 0x00, 0x00 };
 
+// time was set or it's the first sync, the next sync counts the shadow all over
+static bool binary_invalid = true;
+
+// time waiting for its second to start, it's written by timer1 interrupt
+volatile uint8_t rtcc_set_frames = 0;
+volatile bool rtcc_set_pending = false;
+static datetime_t set_time;
+
+static void update_binary(const datetime_t* previous);
+static void update_binary_date(void);
+
 static void rtcc_write_enable()
 {
 	EECON2 = 0x55;
@@ -38,10 +47,22 @@ static void rtcc_write_disable()
 	RTCCFGbits.RTCWREN = 0;
 }
 
+static void rtcc_write_calibration(int8_t value)
+{
+	rtcc_write_enable();
+	RTCCAL = (uint8_t)value;
+	rtcc_write_disable();
+}
+
 bool rtcc_init(void)
 {
 	OSCCON2bits.SOSCGO = 1;
 
+	// calibration is stored with its inverted copy, erased EEPROM means no calibration
+	uint8_t calibration = eeprom_read_byte(RTCC_CALIBRATION_OFFSET);
+	if (eeprom_read_byte(RTCC_CALIBRATION_OFFSET + 1) == (uint8_t)~calibration)
+		rtcc_write_calibration((int8_t)calibration);
+
 	if (!rtcc_enabled())
 	{
 		rtcc_enable();
@@ -75,91 +96,161 @@ void rtcc_enable_alarm(void)
 	ALRMCFGbits.AMASK = 3;
 }
 
+int8_t rtcc_calibration(void)
+{
+	return (int8_t)RTCCAL;
+}
+void rtcc_calibrate(int8_t value)
+{
+	rtcc_write_calibration(value);
+
+	eeprom_update_byte(RTCC_CALIBRATION_OFFSET, (uint8_t)value);
+	eeprom_update_byte(RTCC_CALIBRATION_OFFSET + 1, ~(uint8_t)value);
+}
+
 void rtcc_fix(datetime_t* datetime)
 {
 	uint8_t month_days = rtcc_month_days(datetime);
 	if (datetime->day > month_days)
 		datetime->day = month_days;
 
-	uint8_t year = bcd_to_number(datetime->year);
-	while (year >= sizeof(first_weekday_table))
-		year -= sizeof(first_weekday_table);
-
-	uint8_t month = bcd_to_number(datetime->month) - 1;
-	uint16_t day = bcd_to_number(datetime->day) - 1;
-	for (uint8_t n = 0; n < month; ++n)
-		day += month_days_table[n];
-	if (month >= 1 && (year & 3) == 0)
-		day++;
-	day += first_weekday_table[year];
-
-	datetime->weekday = day % 7;
+	uint16_t epoch_day = calendar_epoch_day(bcd_to_number(datetime->year), bcd_to_number(datetime->month), bcd_to_number(datetime->day));
+	datetime->weekday = calendar_weekday(epoch_day);
 }
 
 void rtcc_set(const datetime_t* datetime, bool keep_seconds)
 {
+	uint8_t values[HAL_RTCC_VALUES] = { datetime->year, 0, datetime->day, datetime->month, datetime->hours, datetime->weekday, datetime->seconds, datetime->minutes };
+
 	rtcc_write_enable();
+	hal_rtcc_write(values, keep_seconds);
+	rtcc_write_disable();
 
-	RTCCFGbits.RTCPTR = 3;
-	while (RTCCFGbits.RTCSYNC);
-	RTCVALL = datetime->year;
-	RTCVALH = 0;
-	RTCVALL = datetime->day;
-	RTCVALH = datetime->month;
-	RTCVALL = datetime->hours;
-	RTCVALH = datetime->weekday;
-	if (!keep_seconds)
-		RTCVALL = datetime->seconds;
-	RTCVALH = datetime->minutes;
+	// callers usually set the global now itself, so the next sync can't tell the change
+	binary_invalid = true;
+}
 
-	rtcc_write_disable();
+void rtcc_set_at(const datetime_t* datetime, uint16_t delay)
+{
+	// timer1 counts 4096Hz, the current frame is cut to the remainder of the delay and whole frames follow,
+	// so the last of their interrupts comes right when the given second starts
+	uint16_t ticks = (uint16_t)(((uint32_t)delay * 4096 + 500) / 1000);
+	if (ticks == 0)
+		ticks = 1;
+	uint16_t timer = 0 - (ticks - ((ticks - 1) & ~511));
+
+	INTCONbits.GIE = 0;
+	set_time = *datetime;
+	rtcc_set_pending = false;
+	rtcc_set_frames = (uint8_t)((ticks + 511) / 512);
+	TMR1H = timer >> 8;
+	TMR1L = timer & 255;
+	PIR1bits.TMR1IF = 0;
+	INTCONbits.GIE = 1;
+}
+
+uint8_t rtcc_set_begin(void)
+{
+	// called by timer1 interrupt when the second starts, the write itself is left to the main loop, the interrupt
+	// would break its RTCPTR reads and EECON2 unlock sequences
+	rtcc_set_pending = true;
+	return bcd_to_number(set_time.seconds);
+}
+
+void rtcc_set_apply(void)
+{
+	if (!rtcc_set_pending)
+		return;
+
+	// writing the seconds resets the RTCC pre-scaler, the RTCC second starts this late after the frame one
+	rtcc_set(&set_time, false);
+	rtcc_set_pending = false;
 }
 
 void rtcc_get(datetime_t* datetime)
 {
-	RTCCFGbits.RTCPTR = 3;
-	while (RTCCFGbits.RTCSYNC);
-	datetime->year = RTCVALL;
-	uint8_t dummy = RTCVALH;
-	datetime->day = RTCVALL;
-	datetime->month = RTCVALH;
-	datetime->hours = RTCVALL;
-	datetime->weekday = RTCVALH;
-	datetime->seconds = RTCVALL;
-	datetime->minutes = RTCVALH;
+	uint8_t values[HAL_RTCC_VALUES];
+	hal_rtcc_read(values);
+
+	datetime->year = values[0];
+	datetime->day = values[2];
+	datetime->month = values[3];
+	datetime->hours = values[4];
+	datetime->weekday = values[5];
+	datetime->seconds = values[6];
+	datetime->minutes = values[7];
 }
 
 void rtcc_sync()
 {
-	RTCCFGbits.RTCPTR = 3;
-	while (RTCCFGbits.RTCSYNC);
-	now.year = RTCVALL;
-	uint8_t dummy = RTCVALH;
-	now.day = RTCVALL;
-	now.month = RTCVALH;
-	now.hours = RTCVALL;
-	now.weekday = RTCVALH;
-	now.seconds = RTCVALL;
-	now.minutes = RTCVALH;
+	datetime_t previous = now;
+
+	rtcc_get(&now);
+
+	update_binary(&previous);
 }
 
 uint8_t rtcc_month_days(datetime_t* datetime)
 {
-	uint8_t days = month_days_table[bcd_to_number(datetime->month) - 1];
-	if (days == 28 && (datetime->year & 3) == 0)
-		days++;
-	return number_to_bcd(days);
+	return number_to_bcd(calendar_month_days(bcd_to_number(datetime->year), bcd_to_number(datetime->month)));
+}
+
+static void update_binary(const datetime_t* previous)
+{
+	bool invalid = binary_invalid;
+	binary_invalid = false;
+
+	if (invalid || now.hours != previous->hours || now.minutes != previous->minutes)
+	{
+		now_binary.hours = bcd_to_number(now.hours);
+		now_binary.minutes = bcd_to_number(now.minutes);
+		now_binary.minute_of_day = now_binary.hours * 60 + now_binary.minutes;
+	}
+
+	if (invalid)
+	{
+		update_binary_date();
+		return;
+	}
+
+	if (now.day == previous->day && now.month == previous->month && now.year == previous->year)
+		return;
+
+	// usually it's just the next day, so it's counted from the previous one
+	uint8_t day = now_binary.day + 1;
+	uint8_t month = now_binary.month;
+	uint8_t year = now_binary.year;
+	if (day > calendar_month_days(year, month))
+	{
+		day = 1;
+		if (++month > 12)
+			month = 1, ++year;
+	}
+
+	if (now.day == number_to_bcd(day) && now.month == number_to_bcd(month) && now.year == number_to_bcd(year))
+	{
+		now_binary.day = day;
+		now_binary.month = month;
+		now_binary.year = year;
+		now_binary.year_day = (month == 1 && day == 1) ? 0 : now_binary.year_day + 1;
+		now_binary.epoch_day++;
+		if (++now_binary.weekday == 7)
+			now_binary.weekday = 0;
+		return;
+	}
+
+	// date jumped (RTCC written behind the shadow), count it all
+	update_binary_date();
 }
 
-uint16_t rtcc_year_day(const datetime_t* datetime)
+static void update_binary_date(void)
 {
-	uint16_t day = bcd_to_number(datetime->day) - 1;
-	uint8_t month = bcd_to_number(datetime->month) - 1;
-	for (uint8_t n = 0; n < month; ++n)
-		day += month_days_table[month];
-	if (month >= 2 && (datetime->year & 3) == 0)
-		day++;
-	return day;
+	now_binary.year = bcd_to_number(now.year);
+	now_binary.month = bcd_to_number(now.month);
+	now_binary.day = bcd_to_number(now.day);
+	now_binary.year_day = calendar_year_day(now_binary.year, now_binary.month, now_binary.day);
+	now_binary.epoch_day = calendar_epoch_day(now_binary.year, now_binary.month, now_binary.day);
+	now_binary.weekday = calendar_weekday(now_binary.epoch_day);
 }
 
 uint8_t bcd_to_number(uint8_t bcd)
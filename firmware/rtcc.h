@@ -18,6 +18,9 @@
 
 #include "types.h"
 
+// EEPROM offset of RTCC calibration (value and its inverted copy)
+#define RTCC_CALIBRATION_OFFSET 0x0000
+
 typedef struct
 {
 	uint8_t year;
@@ -29,18 +32,42 @@ typedef struct
 	uint8_t seconds;
 } datetime_t;
 
+// binary shadow of the current time, updated by rtcc_sync
+typedef struct
+{
+	uint8_t year; // 0-99 (2000-2099)
+	uint8_t month; // 1-12
+	uint8_t day; // 1-31
+	uint8_t weekday; // 0-6 (Monday-Sunday)
+	uint8_t hours;
+	uint8_t minutes;
+	uint16_t minute_of_day; // 0-1439
+	uint16_t year_day; // 0-365
+	uint16_t epoch_day; // days since 2000-01-01
+} timestamp_t;
+
 extern datetime_t now;
+extern timestamp_t now_binary;
+
+// timer1 interrupts left until the second of the time given to rtcc_set_at starts, 0 if none is waiting
+extern volatile uint8_t rtcc_set_frames;
+// the second has started and the main loop writes the time, the RTCC isn't written by interrupts
+extern volatile bool rtcc_set_pending;
 
 bool rtcc_init(void);
 bool rtcc_enabled(void);
 void rtcc_enable(void);
 void rtcc_enable_alarm(void);
+int8_t rtcc_calibration(void);
+void rtcc_calibrate(int8_t value);
 void rtcc_fix(datetime_t* datetime);
 void rtcc_set(const datetime_t* datetime, bool keep_seconds);
+void rtcc_set_at(const datetime_t* datetime, uint16_t delay);
+uint8_t rtcc_set_begin(void);
+void rtcc_set_apply(void);
 void rtcc_get(datetime_t* datetime);
 void rtcc_sync(void);
 uint8_t rtcc_month_days(datetime_t* datetime);
-uint16_t rtcc_year_day(const datetime_t* datetime);
 
 uint8_t bcd_to_number(uint8_t bcd);
 uint8_t number_to_bcd(uint8_t number);
@@ -0,0 +1,136 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scheduler.h"
+#include "rtcc.h"
+
+task_t scheduler_tasks[SCHEDULER_TASKS];
+uint8_t scheduler_tasks_count = 0;
+
+scheduler_stats_t scheduler_stats;
+
+extern volatile uint8_t ticks_seconds;
+extern volatile uint8_t ticks_fractions;
+extern volatile uint8_t ticks_frames;
+
+uint8_t scheduler_add(task_function_t function, uint8_t period, uint8_t delay, uint8_t deadline)
+{
+	if (scheduler_tasks_count == SCHEDULER_TASKS)
+		return TASK_NONE;
+
+	task_t* task = &scheduler_tasks[scheduler_tasks_count];
+	task->function = function;
+	task->period = period;
+	task->delay = delay;
+	task->deadline = deadline;
+	task->late = 0;
+	task->late_max = 0;
+	task->overruns = 0;
+
+	// periodic tasks are pending from the start, one-shot tasks wait to be posted
+	task->pending = (period > 0);
+
+	return scheduler_tasks_count++;
+}
+
+void scheduler_post(uint8_t task, uint8_t delay)
+{
+	if (task >= scheduler_tasks_count)
+		return;
+
+	scheduler_tasks[task].delay = delay;
+	scheduler_tasks[task].late = 0;
+	scheduler_tasks[task].pending = true;
+}
+
+void scheduler_cancel(uint8_t task)
+{
+	if (task >= scheduler_tasks_count)
+		return;
+
+	scheduler_tasks[task].pending = false;
+}
+
+void scheduler_run(uint8_t elapsed_frames)
+{
+	uint8_t frame = ticks_frames;
+
+	// last frame of a minute isn't ended by timer1 reload but by RTCC alarm, which may come a bit sooner
+	// or later, so timer1 doesn't tell its time and the frame isn't measured
+	bool measured = !(ticks_seconds == 59 && (ticks_fractions & 7) == 7);
+
+	// tasks are run in order they were added, so the first ones have the highest priority
+	task_t* task = &scheduler_tasks[0];
+	for (uint8_t n = 0; n < scheduler_tasks_count; ++n, ++task)
+	{
+		if (!task->pending)
+			continue;
+
+		if (task->delay > elapsed_frames)
+		{
+			task->delay -= elapsed_frames;
+			continue;
+		}
+
+		// task is due, count frames it's late
+		uint8_t late = elapsed_frames - task->delay;
+		task->late = (task->late + late < UINT8_MAX) ? task->late + late : UINT8_MAX;
+		task->delay = 0;
+
+		if (task->late < task->deadline && (frame != ticks_frames || (measured && scheduler_frame_time() > SCHEDULER_FRAME_BUDGET)))
+			// frame budget is exhausted, postpone the task to the next frame while it's still in its deadline
+			continue;
+
+		if (task->late > task->deadline && task->overruns < UINT8_MAX)
+			task->overruns++;
+		if (task->late > task->late_max)
+			task->late_max = task->late;
+
+		if (task->period > 0)
+			// keep the period phase even if the task was late
+			task->delay = (task->late < task->period) ? task->period - task->late : 0;
+		else
+			task->pending = false;
+		task->late = 0;
+
+		task->function();
+	}
+
+	// precise time set cut the frame to its phase
+	if (!measured || rtcc_set_frames)
+		return;
+
+	if (frame != ticks_frames)
+	{
+		// work didn't fit into the frame
+		if (scheduler_stats.frame_overruns < UINT8_MAX)
+			scheduler_stats.frame_overruns++;
+	}
+	else
+	{
+		uint16_t frame_time = scheduler_frame_time();
+		if (frame_time > scheduler_stats.frame_time_max)
+			scheduler_stats.frame_time_max = frame_time;
+	}
+}
+
+uint16_t scheduler_frame_time(void)
+{
+	// timer1 is reloaded to 0xFE00 every frame, so it counts 512 ticks per frame
+	uint8_t low = TMR1L;
+	uint16_t time = ((uint16_t)TMR1H << 8) | low;
+	return time - 0xFE00;
+}
@@ -0,0 +1,58 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "types.h"
+
+#define SCHEDULER_TASKS 8
+
+// frame work longer than 3/4 of 125ms frame postpones tasks which may still wait
+#define SCHEDULER_FRAME_BUDGET 384
+
+#define TASK_NONE 0xFF
+
+typedef void (*task_function_t)(void);
+
+typedef struct
+{
+	task_function_t function;
+	uint8_t period; // frames between runs, 0 means one-shot task
+	uint8_t delay; // frames remaining until the task is due
+	uint8_t deadline; // frames the task may be late before it's counted as overrun
+	uint8_t late; // frames the task is already late
+	bool pending;
+
+	// statistics
+	uint8_t late_max;
+	uint8_t overruns;
+} task_t;
+
+typedef struct
+{
+	uint16_t frame_time_max; // longest frame work in 1/4096s units
+	uint8_t frame_overruns; // frames which work didn't fit into 125ms
+} scheduler_stats_t;
+
+extern task_t scheduler_tasks[SCHEDULER_TASKS];
+extern uint8_t scheduler_tasks_count;
+extern scheduler_stats_t scheduler_stats;
+
+uint8_t scheduler_add(task_function_t function, uint8_t period, uint8_t delay, uint8_t deadline);
+void scheduler_post(uint8_t task, uint8_t delay);
+void scheduler_cancel(uint8_t task);
+void scheduler_run(uint8_t elapsed_frames);
+uint16_t scheduler_frame_time(void);
@@ -16,6 +16,24 @@
 
 #include "sensor.h"
 
+extern volatile uint8_t ticks_frames;
+
+enum sensor_state_t
+{
+	SENSOR_IDLE,
+	SENSOR_CHARGING,
+	SENSOR_DRY,
+	SENSOR_WET
+};
+
+// charging ends by timer6 interrupt, which leaves the sample there
+static volatile uint8_t sensor_state = SENSOR_IDLE;
+static uint8_t sensor_sample_frame = 0;
+static uint8_t sensor_integrator = 0;
+static bool rain = false;
+
+static bool set_rain(bool state);
+
 void sensor_init(void)
 {
 	ANCON1 = 0;
@@ -31,18 +49,105 @@ void sensor_init(void)
 	TRISAbits.TRISA3 = 1;
 	TRISJbits.TRISJ0 = 0;
 	PORTJbits.RJ0 = 1;
+
+	sensor_resume();
 }
 
-bool sensor_check(void)
+void sensor_resume(void)
+{
+	// charging cut by the sleep is dropped, the sample is taken again when it's due
+	T6CON = 0;
+	PORTAbits.RA0 = 1;
+	sensor_state = SENSOR_IDLE;
+	sensor_sample_frame = ticks_frames - SENSOR_SAMPLE_PERIOD;
+
+	// configure timer6 to 1:16 pre-scaler, 1:16 post-scaler, charge time period, it's started for each sample
+	PR6 = _XTAL_FREQ / 4 / 16 / 16 * SENSOR_CHARGE_TIME / 1000;
+	PIR5bits.TMR6IF = 0;
+	PIE5bits.TMR6IE = 1;
+}
+
+bool sensor_update(bool watering)
 {
 	// rain sensor bypassed
 	if (PORTAbits.RA3)
-		return false;
+	{
+		T6CON = 0;
+		PORTAbits.RA0 = 1;
+		sensor_state = SENSOR_IDLE;
+		sensor_integrator = 0;
+		return set_rain(false);
+	}
+
+	switch (sensor_state)
+	{
+		case SENSOR_IDLE:
+		{
+			// period is counted by frames, not by the updates, the frames may come in batches
+			uint8_t period = (watering || sensor_integrator > 0) ? SENSOR_SAMPLE_PERIOD_FAST : SENSOR_SAMPLE_PERIOD;
+			if ((uint8_t)(ticks_frames - sensor_sample_frame) < period)
+				return false;
+
+			// enable sensor 24V voltage and let capacitor C113 charge, timer6 ends it
+			sensor_state = SENSOR_CHARGING;
+			PORTAbits.RA0 = 0;
+			TMR6 = 0;
+			PIR5bits.TMR6IF = 0;
+			T6CON = 0b01111110;
+			sensor_sample_frame = ticks_frames;
+			return false;
+		}
+
+		case SENSOR_CHARGING:
+			return false;
 
-	PORTAbits.RA0 = 0;
-	__delay_ms(15); // wait for capacitor C113 to charge
-	bool b = PORTGbits.RG3;
+		case SENSOR_DRY:
+		case SENSOR_WET:
+		{
+			bool wet = (sensor_state == SENSOR_WET);
+
+			sensor_state = SENSOR_IDLE;
+
+			if (wet)
+			{
+				if (sensor_integrator < SENSOR_INTEGRATOR_MAX)
+					sensor_integrator++;
+				if (sensor_integrator >= SENSOR_THRESHOLD_RAIN)
+					return set_rain(true);
+			}
+			else
+			{
+				if (sensor_integrator > 0)
+					sensor_integrator--;
+				if (sensor_integrator == 0)
+					return set_rain(false);
+			}
+			break;
+		}
+	}
+
+	return false;
+}
+
+void sensor_charged(void)
+{
+	// sample is taken and the supply is disabled right away, the frame task picks the sample
+	T6CON = 0;
+	sensor_state = PORTGbits.RG3 ? SENSOR_WET : SENSOR_DRY;
 	PORTAbits.RA0 = 1;
+}
 
-	return b;
-}
\ No newline at end of file
+bool sensor_rain(void)
+{
+	return rain;
+}
+
+static bool set_rain(bool state)
+{
+	// return true only if the state was changed
+	if (rain == state)
+		return false;
+
+	rain = state;
+	return true;
+}
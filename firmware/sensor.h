@@ -18,5 +18,21 @@
 
 #include "types.h"
 
+// dry sensor is sampled every 80 frames (10 seconds), the sensor 24V supply is on for ~0.2% of the time,
+// once it turns wet or while valves are open it's sampled every second, so the rain stops watering in ~3 seconds
+#define SENSOR_SAMPLE_PERIOD 80
+#define SENSOR_SAMPLE_PERIOD_FAST 8
+
+// capacitor C113 needs 15ms to charge, the sample is taken by timer6 interrupt after this time
+#define SENSOR_CHARGE_TIME 16 // ms
+
+// every wet sample increments the integrator and every dry one decrements it, rain is sensed when it rises
+// to the upper threshold and it's cleared when it falls to zero, so a flickering contact doesn't change the state
+#define SENSOR_INTEGRATOR_MAX 6
+#define SENSOR_THRESHOLD_RAIN 3
+
 void sensor_init(void);
-bool sensor_check(void);
\ No newline at end of file
+void sensor_resume(void);
+bool sensor_update(bool watering);
+void sensor_charged(void);
+bool sensor_rain(void);
\ No newline at end of file
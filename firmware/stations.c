@@ -15,6 +15,22 @@
 */
 
 #include "stations.h"
+#include "rtcc.h"
+#include "eeprom.h"
+
+// valve pins of each port (main valve RB4 included)
+#define VALVES_PORTA	0b00100000
+#define VALVES_PORTB	0b00110000
+#define VALVES_PORTC	0b11111100
+
+// record of queued run times saved on power failure
+typedef struct
+{
+	uint16_t epoch_day;
+	uint16_t minute_of_day;
+	uint16_t run_times[NUMBER_OF_STATIONS];
+	uint8_t checksum;
+} stations_record_t;
 
 volatile bool overcurrent_detected = false;
 
@@ -29,11 +45,16 @@ void stations_init(void)
 		station->open = false;
 	}
 
+	stations_resume();
+}
+
+void stations_resume(void)
+{
 	// main valve is always closed
 	PORTBbits.RB4 = CLOSE_VALVE;
 
 	// close station valves 1-8
-	stations_close_all();
+	stations_queue_pause();
 
 	// setup valve ports to output
 	TRISA &= 0b11011111;
@@ -78,6 +99,9 @@ void stations_queue_stop(void)
 	station_state_t* station = &stations_states[0];
 	for (uint8_t n = 0; n < NUMBER_OF_STATIONS; ++n, ++station)
 		station->run_time = 0;
+
+	// cancelled queue isn't resumed by a reset
+	stations_queue_discard();
 }
 
 bool stations_queue_progress(uint16_t* run_time)
@@ -98,6 +122,7 @@ bool stations_queue_progress(uint16_t* run_time)
 void stations_queue_update(uint8_t elapsed_seconds)
 {
 	bool any_valve_in_rush = false;
+	bool station_closed = false;
 	uint8_t valves_opened = stations_opened();
 
 	station_state_t* station_state = &stations_states[0];
@@ -113,6 +138,7 @@ void stations_queue_update(uint8_t elapsed_seconds)
 				stations_close_single(m);
 
 				--valves_opened;
+				station_closed = true;
 				continue;
 			}
 
@@ -139,6 +165,86 @@ void stations_queue_update(uint8_t elapsed_seconds)
 			}
 		}
 	}
+
+	// finished queue isn't resumed by a reset
+	uint16_t run_time;
+	if (station_closed && !stations_queue_progress(&run_time))
+		stations_queue_discard();
+}
+
+void stations_queue_pause(void)
+{
+	stations_close_all();
+
+	// queued stations will be opened again by the queue update
+	station_state_t* station = &stations_states[0];
+	for (uint8_t n = 0; n < NUMBER_OF_STATIONS; ++n, ++station)
+		station->open = false;
+}
+
+static uint8_t record_checksum(const stations_record_t* record)
+{
+	// checksum is stored inverted so the erased record isn't valid
+	uint8_t checksum = 0;
+	const uint8_t* ptr = (const uint8_t*)record;
+	for (uint8_t n = 0; n < sizeof(stations_record_t) - 1; ++n)
+		checksum += ptr[n];
+	return ~checksum;
+}
+
+void stations_queue_save(void)
+{
+	stations_record_t record;
+	record.epoch_day = now_binary.epoch_day;
+	record.minute_of_day = now_binary.minute_of_day;
+
+	bool any_queued = false;
+	for (uint8_t n = 0; n < NUMBER_OF_STATIONS; ++n)
+	{
+		record.run_times[n] = stations_states[n].run_time;
+		if (record.run_times[n] > 0)
+			any_queued = true;
+	}
+
+	if (!any_queued)
+	{
+		// nothing to resume, just make sure the old record isn't used
+		stations_queue_discard();
+		return;
+	}
+
+	// unchanged bytes are not written, so the record usually costs just a few cell writes
+	record.checksum = record_checksum(&record);
+	eeprom_update_data((const uint8_t*)&record, sizeof(record), STATIONS_RECORD_OFFSET);
+}
+
+void stations_queue_restore(void)
+{
+	stations_record_t record;
+	eeprom_read_data((uint8_t*)&record, sizeof(record), STATIONS_RECORD_OFFSET);
+
+	if (record.checksum != record_checksum(&record))
+		// no record saved
+		return;
+
+	// the record is used only once
+	eeprom_write_byte(STATIONS_RECORD_OFFSET + sizeof(record) - 1, ~record.checksum);
+
+	// queue is resumed only after a short outage, not when the unit was unplugged for hours
+	if (record.epoch_day != now_binary.epoch_day || (uint16_t)(now_binary.minute_of_day - record.minute_of_day) > 60)
+		return;
+
+	for (uint8_t n = 0; n < NUMBER_OF_STATIONS; ++n)
+		stations_queue_start(n, record.run_times[n]);
+}
+
+void stations_queue_discard(void)
+{
+	stations_record_t record;
+	eeprom_read_data((uint8_t*)&record, sizeof(record), STATIONS_RECORD_OFFSET);
+
+	if (record.checksum == record_checksum(&record))
+		eeprom_write_byte(STATIONS_RECORD_OFFSET + sizeof(record) - 1, ~record.checksum);
 }
 
 uint8_t stations_queue_mask(void)
@@ -261,4 +367,19 @@ void stations_overcurrent_detected(void)
 	PORTAbits.RA5 = CLOSE_VALVE;
 
 	overcurrent_detected = true;
+}
+
+void stations_power_lost(void)
+{
+	// mains dropped out or supply is failing, close everything by a single write per port
+	// (called from interrupt, so without helper functions)
+#if CLOSE_VALVE
+	LATB |= VALVES_PORTB;
+	LATC |= VALVES_PORTC;
+	LATA |= VALVES_PORTA;
+#else
+	LATB &= (uint8_t)~VALVES_PORTB;
+	LATC &= (uint8_t)~VALVES_PORTC;
+	LATA &= (uint8_t)~VALVES_PORTA;
+#endif
 }
\ No newline at end of file
@@ -20,6 +20,9 @@
 
 #define NUMBER_OF_STATIONS 8
 
+// EEPROM offset of the queue record saved on power failure
+#define STATIONS_RECORD_OFFSET 0x0100
+
 #if XCORE_VERSION == 2
 #define OPEN_VALVE				0
 // 59.5%
@@ -40,11 +43,16 @@ typedef struct
 } station_state_t;
 
 void stations_init(void);
+void stations_resume(void);
 
 bool stations_queue_start(uint8_t number, uint16_t run_time);
 void stations_queue_stop(void);
 bool stations_queue_progress(uint16_t* run_time);
 void stations_queue_update(uint8_t elapsed_seconds);
+void stations_queue_pause(void);
+void stations_queue_save(void);
+void stations_queue_restore(void);
+void stations_queue_discard(void);
 uint8_t stations_queue_mask(void);
 
 uint8_t stations_opened(void);
@@ -52,4 +60,5 @@ void stations_open_single(uint8_t number);
 void stations_close_single(uint8_t number);
 void stations_close_all(void);
 
-void stations_overcurrent_detected(void);
\ No newline at end of file
+void stations_overcurrent_detected(void);
+void stations_power_lost(void);
\ No newline at end of file
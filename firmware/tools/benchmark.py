@@ -0,0 +1,304 @@
+#!/usr/bin/env python3
+#
+#   https://github.com/gashtaan/hunter-xcore-firmware
+#
+#   Copyright (C) 2021, Michal Kovacik
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License version 3, as
+#   published by the Free Software Foundation.
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+
+# Runs the benchmark build of the firmware in gpsim and reports instruction cycles spent in the hot paths.
+#
+# usage: benchmark.py [-p processor] [-s seconds] [-r request] [-l gpsim.log] [-b baseline.json] [-t tolerance] [-o report.json] [hex] [sym]
+#
+# The benchmark configuration is built with BENCHMARK macro, so the probes from benchmark.h write their ids
+# to benchmark_marker. gpsim logs every write of the marker with the cycle counter and the script pairs
+# begins with ends. Cycles spent in the interrupt are subtracted from the probes it interrupted.
+#
+# Stimuli: 32768Hz clock on SOSC input (frames), 50Hz mains on INT0, rain sensor wet for a while
+# and remote requests on PGC/PGD repeated every 5 seconds.
+#
+# With -l the log is only analyzed, so a log captured by other simulator in the same format can be used.
+# With -b the report is compared to a previous one and the script fails if worst case of any probe
+# grew more than the tolerance (percent, 5 by default).
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+CLOCK = 4000000
+CYCLES_PER_SECOND = CLOCK // 4
+FRAME_CYCLES = CYCLES_PER_SECOND // 8
+
+# end marker write is preceded by MOVLW which is counted to the probed code
+PROBE_OVERHEAD = 1
+
+REMOTE_PERIOD = 5 * CYCLES_PER_SECOND
+
+
+def fail(message):
+	sys.exit('benchmark: %s' % message)
+
+
+def probe_names(path):
+	# probe ids are taken from benchmark.h, so they can't get out of sync
+	with open(path) as f:
+		text = f.read()
+
+	m = re.search(r'enum benchmark_probe_t\s*\{(.*?)\}', text, re.S)
+	if not m:
+		fail('no probes in %s' % path)
+
+	names = {}
+	value = 0
+	for name, number in re.findall(r'BENCHMARK_(\w+)\s*(?:=\s*(\d+))?', m.group(1)):
+		value = int(number) if number else value + 1
+		names[value] = name.lower()
+	return names
+
+
+def marker_address(path):
+	# XC8 symbol file lines are <symbol> <address> ...
+	with open(path) as f:
+		for line in f:
+			fields = line.split()
+			if len(fields) >= 2 and fields[0] == '_benchmark_marker':
+				return int(fields[1], 16)
+	fail('_benchmark_marker not found in %s, is it the benchmark build?' % path)
+
+
+def crc_update(crc, data):
+	data ^= crc
+	crc = 0
+	for bit, value in enumerate((0x5e, 0xbc, 0x61, 0xc2, 0x9d, 0x23, 0x46, 0x8c)):
+		if data & (1 << bit):
+			crc ^= value
+	return crc
+
+
+def remote_waveforms(request):
+	# PGC HIGH asks for the transfer, unit answers by PGD HIGH and PGC LOW accepts it, then single bit
+	# a 50us PGC pulse with data on PGD set before the rising edge, the same pulses clock out the response
+	crc = 0
+	for byte in request:
+		crc = crc_update(crc, byte)
+	data = request + [crc]
+
+	clock = [(0, 1), (3000, 0)]
+	pgd = []
+	cycle = 3100
+	for byte in data:
+		for bit in range(8):
+			pgd.append((cycle, (byte >> bit) & 1))
+			clock.append((cycle + 10, 1))
+			clock.append((cycle + 35, 0))
+			cycle += 50
+
+	# accept of the response after the unit detected the packet end and handled it, then clock out
+	# up to 32 bytes, the unit stops sending after its packet and the rest of pulses times out
+	cycle += 1000
+	clock.append((cycle, 1))
+	clock.append((cycle + 100, 0))
+	cycle += 200
+	for n in range(34 * 8):
+		clock.append((cycle + 10, 1))
+		clock.append((cycle + 35, 0))
+		cycle += 50
+
+	pgd.append((cycle, 0))
+	return clock, pgd
+
+
+def stimulus(name, initial, events, period=None):
+	lines = ['stimulus asynchronous_stimulus', 'initial_state %d' % initial, 'start_cycle 0']
+	if period:
+		lines.append('period %d' % period)
+	lines.append('{ ' + ', '.join('%d, %d' % event for event in events) + ' }')
+	lines.append('name %s' % name)
+	lines.append('end')
+	return lines
+
+
+def gpsim_script(args, address, log_path):
+	clock, pgd = remote_waveforms(args.request)
+
+	# remote requests start after the boot
+	offset = 2 * CYCLES_PER_SECOND
+	clock = [(cycle + offset, state) for cycle, state in clock]
+	pgd = [(cycle + offset, state) for cycle, state in pgd]
+
+	lines = ['processor %s' % args.processor, 'load %s' % args.hex]
+
+	# 32768Hz watch crystal, 30.5 cycles a period is rounded to 31
+	lines += stimulus('sosc', 0, [(15, 1)], 31)
+	# mains edges on INT0
+	lines += stimulus('ac', 0, [(CYCLES_PER_SECOND // 100, 1)], CYCLES_PER_SECOND // 50)
+	# rain sensor wet from 30s to 90s of the run
+	lines += stimulus('rain', 0, [(30 * CYCLES_PER_SECOND, 1), (90 * CYCLES_PER_SECOND, 0)])
+	lines += stimulus('pgc', 0, clock, REMOTE_PERIOD)
+	lines += stimulus('pgd', 0, pgd, REMOTE_PERIOD)
+
+	for name, pin in (('sosc', 'portc0'), ('ac', 'portb0'), ('rain', 'portg3'), ('pgc', 'portb6'), ('pgd', 'portb7')):
+		lines.append('node n_%s' % name)
+		lines.append('attach n_%s %s %s' % (name, name, pin))
+
+	lines.append('log on %s' % log_path)
+	lines.append('log w 0x%03x' % address)
+	lines.append('break c %d' % (args.seconds * CYCLES_PER_SECOND))
+	lines.append('run')
+	lines.append('quit')
+	return '\n'.join(lines) + '\n'
+
+
+def run_gpsim(args, address):
+	with tempfile.TemporaryDirectory() as directory:
+		script_path = os.path.join(directory, 'benchmark.stc')
+		log_path = os.path.join(directory, 'benchmark.log')
+		with open(script_path, 'w') as f:
+			f.write(gpsim_script(args, address, log_path))
+
+		try:
+			subprocess.run(['gpsim', '-i', '-c', script_path], check=True, stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL)
+		except (OSError, subprocess.CalledProcessError) as e:
+			fail('gpsim failed: %s' % e)
+
+		with open(log_path) as f:
+			return f.readlines()
+
+
+def parse_log(lines):
+	# gpsim logs writes as: <cycle> <processor> <pc> Wrote: <value> to <register>...
+	writes = []
+	for line in lines:
+		m = re.match(r'\s*(0x[0-9A-Fa-f]+|\d+)\s.*Wrote:\s*(0x[0-9A-Fa-f]+|\d+)\s+to\b', line)
+		if m:
+			writes.append((int(m.group(1), 0), int(m.group(2), 0) & 0xFF))
+	return writes
+
+
+def analyze(writes, names):
+	probes = {name: [] for name in names.values()}
+	open_probes = []
+	last_cycle = 0
+
+	for cycle, value in writes:
+		last_cycle = cycle
+		probe = names.get(value >> 1)
+		if probe is None:
+			continue
+
+		if not value & 1:
+			# cycles of interrupts nested in this probe are collected in the third field
+			open_probes.append([probe, cycle, 0])
+			continue
+
+		# end of probe that hasn't begun (log started in the middle) is ignored
+		for n in range(len(open_probes) - 1, -1, -1):
+			if open_probes[n][0] == probe:
+				break
+		else:
+			continue
+
+		name, begin, nested = open_probes[n]
+		del open_probes[n:]
+
+		cycles = cycle - begin - PROBE_OVERHEAD
+		probes[name].append(cycles - nested)
+		if name == 'isr':
+			for entry in open_probes:
+				entry[2] += cycles + PROBE_OVERHEAD
+
+	report = {'clock': CLOCK, 'cycles': last_cycle, 'frame_cycles': FRAME_CYCLES, 'probes': {}}
+	for name, samples in probes.items():
+		if not samples:
+			continue
+		report['probes'][name] = {
+			'count': len(samples),
+			'min': min(samples),
+			'avg': round(sum(samples) / len(samples), 1),
+			'max': max(samples),
+			'total': sum(samples),
+		}
+
+	if 'frame' in report['probes']:
+		# worst frame as part of the 125ms budget
+		report['frame_load'] = round(report['probes']['frame']['max'] / FRAME_CYCLES, 4)
+
+	return report
+
+
+def compare(report, baseline, tolerance):
+	regressions = []
+	for name, stats in report['probes'].items():
+		previous = baseline.get('probes', {}).get(name)
+		if previous and stats['max'] > previous['max'] * (1 + tolerance / 100):
+			regressions.append('%s worst case %d cycles, was %d' % (name, stats['max'], previous['max']))
+	return regressions
+
+
+def main():
+	base = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+	production = os.path.join(base, 'dist', 'benchmark', 'production')
+
+	parser = argparse.ArgumentParser(description='Cycle benchmark of the firmware hot paths in gpsim.')
+	parser.add_argument('-p', '--processor', default='p18f86k90', help='gpsim processor model')
+	parser.add_argument('-s', '--seconds', type=int, default=120, help='simulated time')
+	parser.add_argument('-r', '--request', default='B1', help='remote request payload in hex, B1 (unit info) by default')
+	parser.add_argument('-l', '--log', help='analyze this gpsim log instead of running gpsim')
+	parser.add_argument('-b', '--baseline', help='previous report to compare the worst cases with')
+	parser.add_argument('-t', '--tolerance', type=float, default=5, help='allowed growth of the worst cases in percent')
+	parser.add_argument('-o', '--output', help='report file, stdout by default')
+	parser.add_argument('hex', nargs='?', default=os.path.join(production, 'Firmware.production.hex'))
+	parser.add_argument('sym', nargs='?', default=os.path.join(production, 'Firmware.production.sym'))
+	args = parser.parse_args()
+
+	try:
+		args.request = list(bytes.fromhex(args.request))
+	except ValueError:
+		fail('request must be hex bytes')
+	if not 0 < len(args.request) < 32:
+		fail('request must have 1-31 bytes')
+
+	names = probe_names(os.path.join(base, 'benchmark.h'))
+
+	if args.log:
+		with open(args.log) as f:
+			lines = f.readlines()
+	else:
+		lines = run_gpsim(args, marker_address(args.sym))
+
+	report = analyze(parse_log(lines), names)
+	if not report['probes']:
+		fail('no probes were hit, check the processor model and stimuli')
+
+	text = json.dumps(report, indent='\t')
+	if args.output:
+		with open(args.output, 'w') as f:
+			f.write(text + '\n')
+	else:
+		print(text)
+
+	if args.baseline:
+		with open(args.baseline) as f:
+			regressions = compare(report, json.load(f), args.tolerance)
+		for regression in regressions:
+			print('benchmark: %s' % regression, file=sys.stderr)
+		if regressions:
+			sys.exit(1)
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+#
+#   https://github.com/gashtaan/hunter-xcore-firmware
+#
+#   Copyright (C) 2021, Michal Kovacik
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License version 3, as
+#   published by the Free Software Foundation.
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+# Generates LCD lookup tables and 7-segment font from the display layout description.
+#
+# usage: lcd_layout.py [display.layout] [display_layout.h]
+
+import os
+import re
+import sys
+
+LCD_DATA_REGISTERS = 24
+FONT_FIRST = ' '
+FONT_LAST = 'z'
+
+
+def fail(line_number, message):
+	sys.exit('display.layout:%d: %s' % (line_number, message))
+
+
+def parse(path):
+	groups = []
+	glyphs = {}
+	section = None
+
+	with open(path) as f:
+		for line_number, line in enumerate(f, 1):
+			line = line.split('#', 1)[0].strip()
+			if not line:
+				continue
+
+			m = re.match(r'^\[(\w+)\]$', line)
+			if m:
+				section = m.group(1)
+				if section != 'glyphs':
+					groups.append((section, []))
+				continue
+
+			if section is None:
+				fail(line_number, 'line outside of any section')
+
+			fields = line.split()
+			if section == 'glyphs':
+				if len(fields[0]) != 1:
+					fail(line_number, 'glyph must be a single character')
+				glyphs[fields[0]] = (line_number, fields[1:])
+			elif fields == ['-']:
+				groups[-1][1].append(None)
+			else:
+				if len(fields) != 3:
+					fail(line_number, 'segment must be <name> <LCDDATA register> <bit>')
+				m = re.match(r'^LCDDATA(\d+)$', fields[1])
+				if not m or int(m.group(1)) >= LCD_DATA_REGISTERS:
+					fail(line_number, 'unknown register %s' % fields[1])
+				bit = int(fields[2])
+				if bit > 7:
+					fail(line_number, 'bit out of range')
+				groups[-1][1].append((fields[0], int(m.group(1)), bit))
+
+	return groups, glyphs
+
+
+def main():
+	base = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+	layout_path = sys.argv[1] if len(sys.argv) > 1 else os.path.join(base, 'display.layout')
+	header_path = sys.argv[2] if len(sys.argv) > 2 else os.path.join(base, 'display_layout.h')
+
+	groups, glyphs = parse(layout_path)
+
+	# every group starts at new byte of the map
+	table = []
+	for name, segments in groups:
+		while len(segments) % 8:
+			segments.append(None)
+		table.append((name, segments))
+
+	used = set()
+	for name, segments in table:
+		for segment in segments:
+			if segment is None:
+				continue
+			if segment[1:] in used:
+				sys.exit('segment LCDDATA%d bit %d is used twice' % segment[1:])
+			used.add(segment[1:])
+
+	# glyph bits follow the segment order of digits, all digits must be ordered the same way
+	digits = [segments for name, segments in table if name.startswith('digit_')]
+	order = [segment[0] for segment in digits[0] if segment]
+	for segments in digits:
+		if [segment[0] for segment in segments if segment] != order:
+			sys.exit('digits differ in segment order')
+
+	font = []
+	for code in range(ord(FONT_FIRST), ord(FONT_LAST) + 1):
+		c = chr(code)
+		glyph = glyphs.get(c) or glyphs.get(c.upper()) or glyphs.get(c.lower())
+		bits = 0
+		if glyph:
+			line_number, names = glyph
+			for name in names:
+				if name not in order:
+					fail(line_number, 'unknown segment %s' % name)
+				bits |= 1 << order.index(name)
+		font.append((c, bits))
+
+	out = []
+	out.append('// generated by tools/lcd_layout.py from display.layout, do not edit')
+	out.append('')
+	out.append('#pragma once')
+	out.append('')
+	out.append('#include "types.h"')
+	out.append('')
+	out.append('#define LCD_SEGMENT(data, bit) ((uint8_t)(data) | ((bit) << 5))')
+	out.append('#define LCD_SEGMENT_NONE() 0xFF')
+	out.append('')
+	out.append('#define LCD_DATA_REGISTERS %d' % LCD_DATA_REGISTERS)
+	out.append('')
+	out.append("#define LCD_FONT_FIRST '%s'" % FONT_FIRST)
+	out.append("#define LCD_FONT_LAST '%s'" % FONT_LAST)
+	out.append('')
+	out.append('// LCDDATA register and bit of every display map bit')
+	out.append('static const uint8_t lcd_segments_table[] =')
+	out.append('{')
+	for n, (name, segments) in enumerate(table):
+		if n:
+			out.append('')
+		out.append('\t// %s' % name)
+		for segment in segments:
+			if segment is None:
+				out.append('\tLCD_SEGMENT_NONE(),')
+			else:
+				out.append('\tLCD_SEGMENT(%d, %d), // %s' % (segment[1], segment[2], segment[0]))
+	out.append('};')
+	out.append('')
+	out.append('// LCDDATA bit mask of every display map bit, so the update doesn\'t shift by the bit number')
+	out.append('static const uint8_t lcd_segments_masks[] =')
+	out.append('{')
+	for n, (name, segments) in enumerate(table):
+		if n:
+			out.append('')
+		out.append('\t// %s' % name)
+		for segment in segments:
+			if segment is None:
+				out.append('\t0b00000000,')
+			else:
+				out.append('\t0b{:08b}, // {}'.format(1 << segment[2], segment[0]))
+	out.append('};')
+	out.append('')
+	out.append('// 7-segment glyphs of characters from LCD_FONT_FIRST to LCD_FONT_LAST, bits in order %s' % ', '.join(order))
+	out.append('static const uint8_t lcd_font[] =')
+	out.append('{')
+	for c, bits in font:
+		out.append("\t0b{:08b}, // {}".format(bits, repr(c)))
+	out.append('};')
+
+	with open(header_path, 'w') as f:
+		f.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+	main()
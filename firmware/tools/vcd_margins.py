@@ -0,0 +1,349 @@
+#!/usr/bin/env python3
+#
+#   https://github.com/gashtaan/hunter-xcore-firmware
+#
+#   Copyright (C) 2021, Michal Kovacik
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License version 3, as
+#   published by the Free Software Foundation.
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+# Measures timing margins of the PGC/PGD link and ICSP sessions in a VCD trace, recorded either by the host
+# link rig (host/link -v, both sides of the wire) or by the module's capture (/capture.vcd, module side only).
+#
+# usage: vcd_margins.py [-v] trace.vcd
+#
+# Link bits are checked against the windows the unit waits for every PGC edge (hal_remote_wait_clock() in
+# remote.c), ICSP bits against the PIC18F86K90 programming specification. Handshake pulses (the first one
+# after the module switched PGD to input, or the one after which it takes PGD over to send) aren't bits
+# and are just counted. The script fails if any budget is violated, with -v the violations are listed.
+
+import argparse
+import bisect
+import re
+import sys
+
+US = 1000
+
+# unit waits for every PGC edge of a bit no longer than 200us, a link packet ends by missing clock
+LINK_EDGE_TIMEOUT = 200 * US
+# unit reads PGD a few instructions after it sees PGC HIGH (1us instruction cycle)
+UNIT_SAMPLE_DELAY = 15 * US
+
+# programming specification: P2 clock period, P2A/P2B clock low/high, P3/P4 data setup/hold to PGC falling
+ICSP_PERIOD = 100
+ICSP_LOW = 40
+ICSP_HIGH = 40
+ICSP_SETUP = 15
+ICSP_HOLD = 15
+# P9/P10 PGC high for the write and low after it, pulses longer than the threshold are taken as writes
+ICSP_WRITE_THRESHOLD = 500 * US
+ICSP_WRITE_HIGH = 1000 * US
+ICSP_WRITE_LOW = 200 * US
+
+# key sequence is 32 bits clocked in while RST is LOW
+ICSP_KEY_BITS = 32
+
+TIMESCALE_UNITS = {'s': 10 ** 9, 'ms': 10 ** 6, 'us': 10 ** 3, 'ns': 1, 'ps': 10 ** -3, 'fs': 10 ** -6}
+
+
+def fail(message):
+	sys.exit('vcd_margins: %s' % message)
+
+
+class Signal:
+	def __init__(self):
+		self.times = []
+		self.values = []
+
+	def change(self, time, value):
+		if self.values and self.values[-1] == value:
+			return
+		if self.times and self.times[-1] == time:
+			self.values[-1] = value
+			return
+		self.times.append(time)
+		self.values.append(value)
+
+	def value(self, time):
+		# value at the time, changes at that time included
+		n = bisect.bisect_right(self.times, time)
+		return self.values[n - 1] if n else 'x'
+
+	def last_change(self, time):
+		# time of the last change at or before the time
+		n = bisect.bisect_right(self.times, time)
+		return self.times[n - 1] if n else None
+
+	def next_change(self, time):
+		# time of the first change after the time
+		n = bisect.bisect_right(self.times, time)
+		return self.times[n] if n < len(self.times) else None
+
+	def edges(self, value):
+		return [time for time, v in zip(self.times, self.values) if v == value]
+
+
+def parse(path):
+	signals = {}
+	ids = {}
+	scope = []
+	scale = 1
+	time = 0
+
+	with open(path) as f:
+		text = f.read()
+
+	header, separator, body = text.partition('$enddefinitions')
+	if not separator:
+		fail('%s: no $enddefinitions' % path)
+
+	for m in re.finditer(r'\$(\w+)(.*?)\$end', header, re.S):
+		keyword, fields = m.group(1), m.group(2).split()
+		if keyword == 'timescale':
+			m = re.match(r'^(\d+)\s*(\w+)$', ' '.join(fields))
+			if not m or m.group(2) not in TIMESCALE_UNITS:
+				fail('%s: unknown timescale %s' % (path, ' '.join(fields)))
+			scale = int(m.group(1)) * TIMESCALE_UNITS[m.group(2)]
+		elif keyword == 'scope':
+			scope.append(fields[1])
+		elif keyword == 'upscope':
+			scope.pop()
+		elif keyword == 'var':
+			name = '.'.join(scope + [fields[3]])
+			signals[name] = Signal()
+			ids.setdefault(fields[2], []).append(signals[name])
+
+	for token in body.split()[1:]:
+		if token[0] == '#':
+			time = int(token[1:]) * scale
+		elif token[0] in '01xXzZ':
+			for signal in ids.get(token[1:], []):
+				signal.change(time, token[0].lower())
+
+	return signals
+
+
+def pulses(clock):
+	# (rise, fall) of every complete HIGH pulse
+	result = []
+	rise = None
+	for time, value in zip(clock.times, clock.values):
+		if value == '1':
+			rise = time
+		elif rise is not None:
+			result.append((rise, time))
+			rise = None
+	return result
+
+
+class Check:
+	def __init__(self, name, budget, minimum):
+		self.name = name
+		self.budget = budget
+		self.minimum = minimum
+		self.values = []
+		self.violations = []
+
+	def add(self, time, value):
+		self.values.append(value)
+		if (value < self.budget) if self.minimum else (value > self.budget):
+			self.violations.append((time, value))
+
+	def margin(self):
+		worst = min(self.values) if self.minimum else max(self.values)
+		return (worst - self.budget) if self.minimum else (self.budget - worst)
+
+
+class Report:
+	def __init__(self):
+		self.checks = {}
+		self.counts = {}
+
+	def add(self, name, budget, minimum, time, value):
+		if name not in self.checks:
+			self.checks[name] = Check(name, budget, minimum)
+		self.checks[name].add(time, value)
+
+	def count(self, name):
+		self.counts[name] = self.counts.get(name, 0) + 1
+
+	def show(self, verbose):
+		print('%-36s %7s %10s %10s %12s %10s %10s' % ('check [us]', 'count', 'min', 'max', 'budget', 'margin', 'violations'))
+		for name in sorted(self.counts):
+			print('%-36s %7d' % (name, self.counts[name]))
+		for name in sorted(self.checks):
+			check = self.checks[name]
+			print('%-36s %7d %10.3f %10.3f %12s %10.3f %10d' % (name, len(check.values), min(check.values) / US, max(check.values) / US,
+				('>= ' if check.minimum else '<= ') + '%.3f' % (check.budget / US), check.margin() / US, len(check.violations)))
+		if verbose:
+			for name in sorted(self.checks):
+				for time, value in self.checks[name].violations:
+					print('%.3f us: %s %.3f' % (time / US, name, value / US))
+		return sum(len(check.violations) for check in self.checks.values())
+
+
+def icsp_sessions(reset, clock):
+	# session starts by RST pulled LOW with the key clocked in and ends by the next RST falling edge
+	sessions = []
+	falls = reset.edges('0')
+	rises = clock.edges('1')
+	for n, fall in enumerate(falls):
+		rise = reset.next_change(fall)
+		key = bisect.bisect_left(rises, rise if rise is not None else float('inf')) - bisect.bisect_right(rises, fall)
+		if key >= ICSP_KEY_BITS:
+			end = falls[n + 1] if n + 1 < len(falls) else float('inf')
+			sessions.append((fall, end))
+	return sessions
+
+
+def check_icsp(report, signals, bits):
+	pgc = signals['module.pgc']
+	pgd = signals['module.pgd']
+
+	for n, (rise, fall) in enumerate(bits):
+		high = fall - rise
+		if high > ICSP_WRITE_THRESHOLD:
+			report.add('icsp write high (P9)', ICSP_WRITE_HIGH, True, rise, high)
+			if n + 1 < len(bits):
+				report.add('icsp write low (P10)', ICSP_WRITE_LOW, True, fall, bits[n + 1][0] - fall)
+			continue
+
+		report.add('icsp clock high (P2B)', ICSP_HIGH, True, rise, high)
+		if n + 1 < len(bits):
+			report.add('icsp clock low (P2A)', ICSP_LOW, True, fall, bits[n + 1][0] - fall)
+			report.add('icsp clock period (P2)', ICSP_PERIOD, True, rise, bits[n + 1][0] - rise)
+
+		# the PIC latches the data on the falling edge
+		if pgd.value(rise) in '01':
+			report.add('icsp data setup (P3)', ICSP_SETUP, True, fall, fall - pgd.last_change(fall))
+			following = pgd.next_change(fall)
+			if following is not None:
+				report.add('icsp data hold (P4)', ICSP_HOLD, True, fall, following - fall)
+
+
+def handshake(pgd, bits, n):
+	rise, fall = bits[n]
+	if pgd.value(rise) != 'z':
+		return False
+
+	# module switches PGD to input before every transfer, then it asks for the transfer by PGC HIGH
+	switched = pgd.last_change(rise)
+	if switched is not None and (n == 0 or switched >= bits[n - 1][1]):
+		return True
+
+	# module takes PGD over right after the other side accepted its transfer
+	following = pgd.next_change(rise)
+	return following is not None and pgd.value(following) != 'z' and (n + 1 == len(bits) or following <= bits[n + 1][0])
+
+
+def check_link(report, signals, bits):
+	pgd = signals['module.pgd']
+	pgd_in = signals['module.pgd_in']
+	unit = 'unit.pgc' in signals
+
+	# unit's view of PGC pairs with the module's one pulse by pulse (the wire keeps the order of changes),
+	# when the wire swallowed some pulse, the first one the unit saw since the module's rise is taken
+	if unit:
+		unit_bits = pulses(signals['unit.pgc'])
+		unit_rises = [rise for rise, fall in unit_bits]
+		module_rises = [rise for rise, fall in pulses(signals['module.pgc'])]
+		paired = len(unit_rises) == len(module_rises)
+		unit_pgd_in = signals['unit.pgd_in']
+
+	previous = None
+	previous_pulse = None
+	bit_count = 0
+	for n, (rise, fall) in enumerate(bits):
+		if handshake(pgd, bits, n):
+			report.count('link handshakes')
+			previous = None
+			bit_count = 0
+			continue
+
+		write = pgd.value(rise) in '01'
+		direction = 'write' if write else 'read'
+
+		# edges as the unit sees them, the module's ones when only they are known
+		seen_rise, seen_fall = rise, fall
+		if unit:
+			pulse = bisect.bisect_left(module_rises, rise)
+			if not paired:
+				following = module_rises[pulse + 1] if pulse + 1 < len(module_rises) else None
+				pulse = bisect.bisect_left(unit_rises, rise)
+				if pulse < len(unit_bits) and following is not None and unit_rises[pulse] >= following:
+					pulse = len(unit_bits)
+			if pulse < len(unit_bits):
+				if pulse == previous_pulse:
+					# the unit saw both pulses as one
+					report.count('link pulses lost')
+					continue
+				previous_pulse = pulse
+				seen_rise, seen_fall = unit_bits[pulse]
+
+		report.add('link %s bit high' % direction, LINK_EDGE_TIMEOUT, False, seen_rise, seen_fall - seen_rise)
+
+		if previous is not None:
+			low = seen_rise - previous
+			# missing clock after a whole written byte ends the packet
+			if write and bit_count % 8 == 0 and low > LINK_EDGE_TIMEOUT:
+				report.count('link packets written')
+				bit_count = 0
+			else:
+				report.add('link %s bit low' % direction, LINK_EDGE_TIMEOUT, False, seen_rise, low)
+		previous = seen_fall
+		bit_count += 1
+
+		if write and unit:
+			# unit samples PGD shortly after it sees PGC HIGH
+			report.add('link write setup (unit)', 0, True, seen_rise, seen_rise - unit_pgd_in.last_change(seen_rise))
+			following = unit_pgd_in.next_change(seen_rise)
+			if following is not None:
+				report.add('link write hold (unit)', UNIT_SAMPLE_DELAY, True, seen_rise, following - seen_rise)
+		elif write:
+			report.add('link write setup (module)', 0, True, rise, rise - pgd.last_change(rise))
+		elif unit:
+			# module samples PGD right before it drops PGC, the module capture records PGD only when it's read
+			report.add('link read setup (module)', 0, True, fall, fall - pgd_in.last_change(fall))
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Timing margins of the PGC/PGD link and ICSP in a VCD trace.')
+	parser.add_argument('-v', action='store_true', help='list the violations')
+	parser.add_argument('trace')
+	args = parser.parse_args()
+
+	signals = parse(args.trace)
+	for name in ('module.rst', 'module.pgc', 'module.pgd', 'module.pgd_in'):
+		if name not in signals:
+			fail('%s: signal %s missing' % (args.trace, name))
+
+	sessions = icsp_sessions(signals['module.rst'], signals['module.pgc'])
+	icsp_bits = []
+	link_bits = []
+	for rise, fall in pulses(signals['module.pgc']):
+		if any(start <= rise < end for start, end in sessions):
+			icsp_bits.append((rise, fall))
+		else:
+			link_bits.append((rise, fall))
+
+	report = Report()
+	check_link(report, signals, link_bits)
+	check_icsp(report, signals, icsp_bits)
+	for n in range(len(sessions)):
+		report.count('icsp sessions')
+
+	violations = report.show(args.v)
+	if violations:
+		fail('%d violations' % violations)
+
+
+if __name__ == '__main__':
+	main()
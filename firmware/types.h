@@ -20,7 +20,7 @@
 
 #define XCORE_VERSION 3
 
-#include <xc.h>
+#include "hal.h"
 
 #include <stdint.h>
 #include <stdbool.h>
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include "controls.h"
 #include "programs.h"
 #include "sensor.h"
+#include "benchmark.h"
 
 uint8_t selection = 0;
 uint8_t selection_previous = 0;
@@ -30,11 +31,16 @@ uint8_t program_number = 0;
 bool programs_changed = false;
 
 uint8_t blink_delay = 0;
+static bool blink_phase = false;
 static bool in_blink(void);
 
+// events collected since the last update
+static uint8_t ui_events = 0xFF;
+static uint8_t collect_events(void);
+static uint8_t screen_events(void);
+
 uint8_t buttons = 0;
-uint8_t buttons_repeat = 0;
-static void update_buttons(void);
+static void update_controls(void);
 
 uint8_t idle_time = 0;
 
@@ -42,6 +48,8 @@ extern volatile bool ac_sensed;
 extern volatile bool rain_sensed;
 extern volatile bool overcurrent_detected;
 
+extern volatile uint8_t ticks_frames;
+extern volatile uint8_t ticks_seconds;
 extern volatile uint8_t ticks_fractions;
 
 static uint8_t update_number(uint8_t number, uint8_t min, uint8_t max, bool increase);
@@ -53,54 +61,76 @@ void ui_init(void)
 	controls_init();
 }
 
-void ui_update(void)
+void ui_resume(void)
 {
-	display_clear();
+	display_resume();
+	ui_refresh();
+}
+
+void ui_flush(void)
+{
+	// save programs changes not saved yet
+	if (programs_changed)
+	{
+		programs_changed = false;
+		programs_save();
+	}
+}
 
-	update_buttons();
+void ui_update(void)
+{
+	uint8_t events = collect_events();
 
 	if (overcurrent_detected && ac_sensed)
 	{
 		// display ERR until any button is pressed
 		if (!buttons)
 		{
-			if (!(ticks_fractions & 4))
+			if (events & (UI_EVENT_BLINK | UI_EVENT_STATUS))
 			{
-				display_digit_segments(3, 0b01011011);
-				display_digit_segments(4, 0b00011000);
-				display_digit_segments(5, 0b00011000);
+				display_clear();
+				if (!blink_phase)
+					display_text(3, "Err");
+
+				BENCHMARK_BEGIN(BENCHMARK_DISPLAY_UPDATE);
 				display_update();
+				BENCHMARK_END(BENCHMARK_DISPLAY_UPDATE);
 			}
 			return;
 		}
 
 		overcurrent_detected = false;
+		events |= UI_EVENT_STATUS;
 	}
 
-	// button right pressed longer that 3 second selects FUNCTION_START_STATIONS
-	if (buttons == RIGHT && buttons_repeat == 24)
-		ui_change_selection(FUNCTION_START_STATIONS);
-
 	// increment idle time, or reset it when any button is pressed or rotary controller changed
-	if (idle_time < 255)
+	if ((events & UI_EVENT_FRAME) && idle_time < 255)
 		++idle_time;
 	if (buttons)
 		idle_time = 0;
 
-	// update selection if rotary controller changed
-	uint8_t s = controls_selection();
-	if (s != FUNCTION_NONE && s != selection_previous)
-	{
-		ui_change_selection(s);
-		idle_time = 0;
-	}
+	// save display power when nobody is at the panel, even more when running from battery
+	if (idle_time < UI_IDLE_DISPLAY_TIME)
+		display_power(DISPLAY_POWER_FULL);
+	else
+		display_power(ac_sensed ? DISPLAY_POWER_IDLE : DISPLAY_POWER_LOW);
 
-	if (programs_changed && !buttons)
+	if (programs_changed && !controls_buttons())
 	{
 		programs_changed = false;
 		programs_save();
 	}
 
+	// selection might have been changed above
+	events |= ui_events;
+	ui_events = 0;
+
+	// screen is rendered only when any of its inputs changed
+	if (!(events & screen_events()))
+		return;
+
+	display_clear();
+
 	switch (selection)
 	{
 		case FUNCTION_RUN:
@@ -141,7 +171,7 @@ void ui_update(void)
 	if (selection == FUNCTION_RUN || selection == FUNCTION_OFF || selection == FUNCTION_PROGRESS)
 	{
 		// blink CYCLE icon is no AC is sensed
-		if (!ac_sensed && !(ticks_fractions & 4))
+		if (!ac_sensed && !blink_phase)
 			display_set_other_icons(ICON_CYCLE);
 
 		if (rain_sensed)
@@ -152,12 +182,20 @@ void ui_update(void)
 		{
 			display_drops(stations_mask, 0);
 
-			if (!(ticks_fractions & 4))
+			if (!blink_phase)
 				display_set_other_icons(ICON_SPRAY);
 		}
 	}
 
+	BENCHMARK_BEGIN(BENCHMARK_DISPLAY_UPDATE);
 	display_update();
+	BENCHMARK_END(BENCHMARK_DISPLAY_UPDATE);
+}
+
+void ui_refresh(void)
+{
+	// render the screen again on the next update, i.e. after its data were changed remotely
+	ui_events = 0xFF;
 }
 
 void ui_run(void)
@@ -169,7 +207,7 @@ void ui_run(void)
 
 	display_weekdays((uint8_t)(1 << now.weekday));
 
-	if (!RTCCFGbits.HALFSEC)
+	if (!blink_phase)
 		display_set_calendar_icons(ICON_TIME_COMMA);
 
 	uint16_t bars = 1;
@@ -208,6 +246,7 @@ void ui_current_time(void)
 
 		rtcc_fix(&now);
 		rtcc_set(&now, true);
+		rtcc_sync();
 
 		blink_delay = 8;
 	}
@@ -302,11 +341,7 @@ void ui_start_times(void)
 	{
 		// OFF
 		if (!blink)
-		{
-			display_digit_segments(3, 0b01110111);
-			display_digit_segments(4, 0b00011011);
-			display_digit_segments(5, 0b00011011);
-		}
+			display_text(3, "OFF");
 	}
 	else
 	{
@@ -409,16 +444,10 @@ void ui_calendar(void)
 				// skip days
 				calendar->days = update_number(calendar->days, 0, 7, (buttons & PLUS));
 				{
-					datetime_t now;
-					rtcc_get(&now);
-
 					// if programmed start time already passed today, next day is planned
-					bool today_passed = false;
-					program_start_time_t start_time = programs[program_number].start_time;
-					if (now.hours > start_time.hour || (now.hours == start_time.hour && now.minutes > start_time.minute))
-						today_passed = true;
+					bool today_passed = (now_binary.minute_of_day > programs_start_minute(&programs[program_number].start_time));
 
-					calendar->offset = (rtcc_year_day(&now) + today_passed) % (calendar->days + 1);
+					calendar->offset = (now_binary.epoch_day + today_passed) % (calendar->days + 1);
 				}
 				break;
 			case 9:
@@ -508,9 +537,7 @@ void ui_off(void)
 		stations_queue_stop();
 	}
 
-	display_digit_segments(3, 0b01110111);
-	display_digit_segments(4, 0b00011011);
-	display_digit_segments(5, 0b00011011);
+	display_text(3, "OFF");
 }
 
 void ui_start_stations(void)
@@ -523,7 +550,7 @@ void ui_start_stations(void)
 	if (selection_tab == 0)
 	{
 		// wait for button RIGHT being un-pressed
-		if (buttons == RIGHT && buttons_repeat > 0)
+		if (controls_buttons() & RIGHT)
 			return;
 
 		for (uint8_t n = 0; n < NUMBER_OF_STATIONS; ++n)
@@ -601,7 +628,7 @@ void ui_progress(void)
 		return ui_change_selection(selection_previous);
 
 	// show progress on display
-	if (!(ticks_fractions & 4))
+	if (!blink_phase)
 		display_set_calendar_icons(ICON_TIME_COMMA);
 
 	uint8_t hours = number_to_bcd(most_recent_run_time / 3600);
@@ -629,35 +656,134 @@ void ui_change_selection(uint8_t number)
 		selection_previous = selection;
 
 	selection_tab = 0;
+
+	ui_events |= UI_EVENT_SELECTION;
 }
 
 static bool in_blink(void)
 {
-	bool blink = false;
-	if (blink_delay > 0)
-		blink_delay--;
-	else
-		blink = (ticks_fractions & 4);
-
-	return blink;
+	// edited value doesn't blink for a while after its change
+	return (blink_delay == 0 && blink_phase);
 }
 
-static void update_buttons(void)
+static uint8_t collect_events(void)
 {
-	static uint8_t buttons_previous = 0;
+	uint8_t events = ui_events;
+	ui_events = 0;
 
-	buttons = controls_buttons();
-	if (buttons == buttons_previous)
+	// ui is updated every frame, and also right after any control event
+	static uint8_t frame_previous = 0;
+	if (ticks_frames != frame_previous)
 	{
-		if (buttons_repeat < 255)
-			buttons_repeat++;
-		if (buttons_repeat < 3)
-			buttons = 0;
+		frame_previous = ticks_frames;
+		events |= UI_EVENT_FRAME;
+
+		if (blink_delay > 0 && --blink_delay == 0)
+			events |= UI_EVENT_BLINK;
 	}
-	else
+
+	update_controls();
+	if (buttons)
+		events |= UI_EVENT_BUTTONS;
+
+	// blink phase follows the second ticks, 4 frames on and 4 off
+	bool blink = (ticks_fractions & 4);
+	if (blink != blink_phase)
+	{
+		blink_phase = blink;
+		events |= UI_EVENT_BLINK;
+	}
+
+	static uint8_t seconds_previous = 0;
+	if (ticks_seconds != seconds_previous)
+	{
+		seconds_previous = ticks_seconds;
+		events |= UI_EVENT_SECOND;
+	}
+
+	static uint8_t minutes_previous = 0xFF;
+	if (now.minutes != minutes_previous)
+	{
+		minutes_previous = now.minutes;
+		events |= UI_EVENT_MINUTE;
+	}
+
+	static uint8_t queue_previous = 0;
+	uint8_t queue = stations_queue_mask();
+	if (queue != queue_previous)
+	{
+		queue_previous = queue;
+		events |= UI_EVENT_QUEUE;
+	}
+
+	static uint8_t status_previous = 0;
+	uint8_t status = (ac_sensed ? 1 : 0) | (rain_sensed ? 2 : 0) | (overcurrent_detected ? 4 : 0);
+	if (status != status_previous)
+	{
+		status_previous = status;
+		events |= UI_EVENT_STATUS;
+	}
+
+	return events;
+}
+
+static uint8_t screen_events(void)
+{
+	// events the current screen depends on
+	switch (selection)
+	{
+		case FUNCTION_RUN:
+			return UI_EVENT_SELECTION | UI_EVENT_MINUTE | UI_EVENT_BLINK | UI_EVENT_QUEUE | UI_EVENT_STATUS;
+		case FUNCTION_CURRENT_TIME:
+			return UI_EVENT_SELECTION | UI_EVENT_BUTTONS | UI_EVENT_BLINK | UI_EVENT_MINUTE;
+		case FUNCTION_START_TIMES:
+		case FUNCTION_RUN_TIMES:
+		case FUNCTION_CALENDAR:
+			return UI_EVENT_SELECTION | UI_EVENT_BUTTONS | UI_EVENT_BLINK;
+		case FUNCTION_SEASONAL_ADJUSTMENT:
+			return UI_EVENT_SELECTION | UI_EVENT_BUTTONS;
+		case FUNCTION_PROGRESS:
+			return UI_EVENT_SELECTION | UI_EVENT_SECOND | UI_EVENT_BLINK | UI_EVENT_QUEUE | UI_EVENT_STATUS;
+		case FUNCTION_OFF:
+			// counts frames
+			return UI_EVENT_FRAME;
+		case FUNCTION_START_STATIONS:
+			return UI_EVENT_FRAME | UI_EVENT_BUTTONS;
+	}
+
+	return UI_EVENT_SELECTION;
+}
+
+static void update_controls(void)
+{
+	buttons = 0;
+
+	controls_event_t event;
+	while (controls_event(&event))
 	{
-		buttons_previous = buttons;
-		buttons_repeat = 0;
+		switch (event.type)
+		{
+			case CONTROLS_EVENT_PRESS:
+			case CONTROLS_EVENT_REPEAT:
+				// single press is handled per update, the next one is left for the next update
+				buttons = event.value;
+				return;
+
+			case CONTROLS_EVENT_LONG:
+				// button right pressed longer that 3 second selects FUNCTION_START_STATIONS
+				if (event.value == RIGHT)
+					ui_change_selection(FUNCTION_START_STATIONS);
+				break;
+
+			case CONTROLS_EVENT_SELECTION:
+				// update selection if rotary controller changed
+				if (event.value != selection_previous)
+				{
+					ui_change_selection(event.value);
+					idle_time = 0;
+				}
+				break;
+		}
 	}
 }
 
@@ -18,8 +18,26 @@
 
 #include "types.h"
 
+enum ui_events_t
+{
+	UI_EVENT_BUTTONS = 1,
+	UI_EVENT_SELECTION = 2,
+	UI_EVENT_MINUTE = 4,
+	UI_EVENT_BLINK = 8,
+	UI_EVENT_QUEUE = 16,
+	UI_EVENT_STATUS = 32,
+	UI_EVENT_SECOND = 64,
+	UI_EVENT_FRAME = 128
+};
+
+// frames without any control activity before the display goes to low power (30 seconds)
+#define UI_IDLE_DISPLAY_TIME 240
+
 void ui_init(void);
+void ui_resume(void);
+void ui_flush(void);
 void ui_update(void);
+void ui_refresh(void);
 
 void ui_run(void);
 void ui_current_time(void);
@@ -0,0 +1,111 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// host (x86 Linux) emulation of the Arduino core used by the remote module, just the parts it uses,
+// time is simulated and advances only while the code waits (see esp_host.h)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+
+#define DEC 10
+
+#define IRAM_ATTR
+
+// flash is just memory here
+#define PROGMEM
+#define PGM_P const char*
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define memcpy_P memcpy
+
+#define constrain(value, low, high) ((value) < (low) ? (low) : ((value) > (high) ? (high) : (value)))
+
+class String : public std::string
+{
+public:
+	String() {}
+	String(const char* text) : std::string(text) {}
+	String(const std::string& text) : std::string(text) {}
+
+	template<typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+	String(T value, int base = DEC) : std::string(base == 16 ? hex(value) : std::to_string(value)) {}
+
+	void replace(const String& from, const String& to)
+	{
+		if (from.empty())
+			return;
+		for (size_t position = 0; (position = find(from, position)) != npos; position += to.size())
+			std::string::replace(position, from.size(), to);
+	}
+
+	long toInt() const
+	{
+		return strtol(c_str(), nullptr, 10);
+	}
+
+private:
+	template<typename T>
+	static std::string hex(T value)
+	{
+		char text[24];
+		snprintf(text, sizeof(text), "%llx", (unsigned long long)value);
+		return text;
+	}
+};
+
+// CPU runs at 80MHz, its cycle counter follows the simulated time
+class EspClass
+{
+public:
+	uint32_t getCycleCount();
+	uint8_t getCpuFreqMHz() { return 80; }
+};
+
+extern EspClass ESP;
+
+void pinMode(uint8_t pin, int mode);
+void digitalWrite(uint8_t pin, int level);
+int digitalRead(uint8_t pin);
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// SNTP keeps the system time, it's derived from the simulated time
+void configTime(long timezone, int daylight, const char* server);
+int esp_host_gettimeofday(struct timeval* tv, void* tz);
+time_t esp_host_time(time_t* t);
+#define gettimeofday esp_host_gettimeofday
+#define time(t) esp_host_time(t)
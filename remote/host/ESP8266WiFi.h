@@ -0,0 +1,55 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Arduino.h"
+
+enum WiFiMode_t { WIFI_OFF, WIFI_STA };
+enum WiFiSleepType_t { WIFI_NONE_SLEEP };
+enum wl_status_t { WL_CONNECTED = 3 };
+
+class IPAddress
+{
+public:
+	IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address{ a, b, c, d } {}
+
+	uint8_t address[4];
+};
+
+class WiFiClient
+{
+public:
+	static void setDefaultNoDelay(bool) {}
+	static void setDefaultSync(bool) {}
+};
+
+// network is always connected
+class ESP8266WiFiClass
+{
+public:
+	void persistent(bool) {}
+	bool setSleepMode(WiFiSleepType_t) { return true; }
+	bool mode(WiFiMode_t) { return true; }
+	bool config(IPAddress, IPAddress, IPAddress, IPAddress) { return true; }
+	bool hostname(const char*) { return true; }
+	bool setAutoReconnect(bool) { return true; }
+	wl_status_t begin(const char*, const char*) { return WL_CONNECTED; }
+	wl_status_t status() { return WL_CONNECTED; }
+	int32_t RSSI() { return -60; }
+};
+
+extern ESP8266WiFiClass WiFi;
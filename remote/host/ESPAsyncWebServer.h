@@ -0,0 +1,158 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Arduino.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+
+// requests are passed in by esp_host_request() and dispatched between iterations of loop() like events
+// of the async TCP stack, responses are rendered as a whole when they are sent
+
+enum WebRequestMethod
+{
+	HTTP_GET = 0b00000001,
+	HTTP_POST = 0b00000010,
+	HTTP_ANY = 0b01111111
+};
+
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerRequest;
+
+typedef std::function<void(AsyncWebServerRequest* request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<size_t(uint8_t* buffer, size_t max_len, size_t index)> AwsResponseFiller;
+typedef std::function<void()> ArDisconnectHandler;
+
+class AsyncWebHeader
+{
+public:
+	AsyncWebHeader(const String& name, const String& value) : header_name(name), header_value(value) {}
+
+	const String& name() const { return header_name; }
+	const String& value() const { return header_value; }
+
+private:
+	String header_name;
+	String header_value;
+};
+
+class AsyncWebServerResponse
+{
+public:
+	AsyncWebServerResponse(int code, const String& content_type, const std::string& content = std::string()) : code(code), content_type(content_type), content(content) {}
+	virtual ~AsyncWebServerResponse() {}
+
+	void setCode(int code) { this->code = code; }
+	void addHeader(const String& name, const String& value) { headers += name + ": " + value + "\n"; }
+
+	// whole content of the response
+	virtual std::string render() { return content; }
+
+	int code;
+	String content_type;
+	std::string headers;
+
+protected:
+	std::string content;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse
+{
+public:
+	AsyncResponseStream(const String& content_type) : AsyncWebServerResponse(200, content_type) {}
+
+	size_t write(const uint8_t* data, size_t len) { content.append((const char*)data, len); return len; }
+	size_t write(uint8_t data) { content += char(data); return 1; }
+	size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+};
+
+class AsyncChunkedResponse : public AsyncWebServerResponse
+{
+public:
+	AsyncChunkedResponse(const String& content_type, AwsResponseFiller filler) : AsyncWebServerResponse(200, content_type), filler(filler) {}
+
+	std::string render() override
+	{
+		// filled in TCP segment sized chunks until the filler has nothing more
+		uint8_t buffer[1024];
+		for (size_t length; (length = filler(buffer, sizeof(buffer), content.size())) != 0; )
+			content.append((const char*)buffer, length);
+		return content;
+	}
+
+private:
+	AwsResponseFiller filler;
+};
+
+class AsyncWebServerRequest
+{
+public:
+	const String& url() const { return path; }
+	WebRequestMethod method() const { return request_method; }
+
+	bool hasArg(const char* name) const { return args.count(name) != 0; }
+	const String& arg(const String& name) const;
+	bool hasHeader(const String& name) const { return headers.count(name) != 0; }
+	AsyncWebHeader* getHeader(const String& name) const;
+
+	// called when the request is gone, after its response is sent or the client disconnected
+	void onDisconnect(ArDisconnectHandler fn) { disconnect_handler = fn; }
+
+	AsyncWebServerResponse* beginResponse(int code, const String& content_type = String(), const String& content = String());
+	AsyncWebServerResponse* beginResponse_P(int code, const String& content_type, const uint8_t* content, size_t len);
+	AsyncWebServerResponse* beginChunkedResponse(const String& content_type, AwsResponseFiller filler);
+	AsyncResponseStream* beginResponseStream(const String& content_type, size_t buffer_size = 1460);
+
+	void send(AsyncWebServerResponse* response);
+	void send(int code, const String& content_type = String(), const String& content = String()) { send(beginResponse(code, content_type, content)); }
+	void redirect(const String& url);
+
+	// emulation
+	int id;
+	String path;
+	WebRequestMethod request_method;
+	std::map<std::string, String> args;
+	std::map<std::string, std::unique_ptr<AsyncWebHeader>> headers;
+	ArDisconnectHandler disconnect_handler;
+	bool sent = false;
+};
+
+class AsyncWebServer
+{
+public:
+	AsyncWebServer(int port) {}
+
+	void on(const char* uri, ArRequestHandlerFunction on_request) { on(uri, HTTP_ANY, on_request); }
+	void on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction on_request, ArUploadHandlerFunction on_upload = nullptr);
+	void onNotFound(ArRequestHandlerFunction fn) { not_found = fn; }
+	void begin();
+
+	// emulation
+	struct route_t
+	{
+		WebRequestMethodComposite method;
+		ArRequestHandlerFunction on_request;
+		ArUploadHandlerFunction on_upload;
+	};
+
+	std::map<std::string, route_t> routes;
+	ArRequestHandlerFunction not_found;
+};
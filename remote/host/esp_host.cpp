@@ -0,0 +1,373 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "esp_host.h"
+#include "ESP8266WiFi.h"
+#include "ESPAsyncWebServer.h"
+#include "ArduinoOTA.h"
+
+#include <ucontext.h>
+#include <algorithm>
+#include <list>
+
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+ArduinoOTAClass ArduinoOTA;
+
+void (*esp_host_pin_changed)(uint8_t pin, bool output, bool level) = nullptr;
+bool (*esp_host_pin_read)(uint8_t pin) = nullptr;
+
+// the module runs in its own context (coroutine), the host program and the module switch between each other
+static ucontext_t host_context;
+static ucontext_t module_context;
+static uint8_t module_stack[256 * 1024];
+
+static uint64_t now_us = 0;
+static uint64_t wake_us = 0;
+static uint64_t epoch = 0;
+
+static bool pin_outputs[17];
+static bool pin_levels[17];
+
+// loop() that has done nothing (no pin change, delay or request) waits a while before it's run again
+static bool module_active = false;
+
+// requests waiting for dispatch, dispatched ones waiting for their responses and the responses
+struct incoming_request_t
+{
+	int id;
+	std::string uri;
+	bool post;
+	std::string data;
+	std::string headers;
+};
+
+struct response_t
+{
+	int code;
+	std::string content;
+	std::string headers;
+};
+
+static AsyncWebServer* web_server = nullptr;
+static int request_id = 0;
+static std::list<incoming_request_t> incoming_requests;
+static std::list<AsyncWebServerRequest*> sent_requests;
+static std::map<int, response_t> responses;
+
+static void wait_until(uint64_t time)
+{
+	wake_us = time;
+	swapcontext(&module_context, &host_context);
+}
+
+static void dispatch_requests(void);
+
+static void module_main(void)
+{
+	setup();
+	for (;;)
+	{
+		module_active = false;
+		loop();
+
+		// network events are handled between iterations of the loop
+		dispatch_requests();
+
+		if (!module_active)
+			wait_until(now_us + 1000);
+	}
+}
+
+void esp_host_start(uint64_t epoch_us)
+{
+	epoch = epoch_us;
+
+	getcontext(&module_context);
+	module_context.uc_stack.ss_sp = module_stack;
+	module_context.uc_stack.ss_size = sizeof(module_stack);
+	module_context.uc_link = nullptr;
+	makecontext(&module_context, module_main, 0);
+}
+
+void esp_host_run(uint64_t now)
+{
+	now_us = now;
+	swapcontext(&host_context, &module_context);
+}
+
+uint64_t esp_host_wake_time(void)
+{
+	return wake_us;
+}
+
+int esp_host_request(const std::string& uri, const std::string* data, const std::string& headers)
+{
+	incoming_requests.push_back({ ++request_id, uri, data != nullptr, data ? *data : std::string(), headers });
+
+	// waiting loop picks it up right away
+	wake_us = now_us;
+	return request_id;
+}
+
+bool esp_host_response(int id, int* code, std::string* content, std::string* headers)
+{
+	auto response = responses.find(id);
+	if (response == responses.end())
+		return false;
+
+	*code = response->second.code;
+	*content = response->second.content;
+	if (headers)
+		*headers = response->second.headers;
+	responses.erase(response);
+	return true;
+}
+
+void pinMode(uint8_t pin, int mode)
+{
+	module_active = true;
+	pin_outputs[pin] = (mode == OUTPUT);
+	if (esp_host_pin_changed)
+		esp_host_pin_changed(pin, pin_outputs[pin], pin_levels[pin]);
+}
+
+void digitalWrite(uint8_t pin, int level)
+{
+	module_active = true;
+	pin_levels[pin] = level;
+	if (esp_host_pin_changed)
+		esp_host_pin_changed(pin, pin_outputs[pin], pin_levels[pin]);
+}
+
+int digitalRead(uint8_t pin)
+{
+	if (pin_outputs[pin] || !esp_host_pin_read)
+		return pin_levels[pin];
+	return esp_host_pin_read(pin);
+}
+
+uint32_t EspClass::getCycleCount()
+{
+	return (uint32_t)(now_us * getCpuFreqMHz());
+}
+
+unsigned long micros()
+{
+	// polling the time takes a microsecond
+	wait_until(now_us + 1);
+	return (unsigned long)now_us;
+}
+
+unsigned long millis()
+{
+	wait_until(now_us + 1);
+	return (unsigned long)(now_us / 1000);
+}
+
+void delay(unsigned long ms)
+{
+	module_active = true;
+	uint64_t time = now_us + ms * 1000ULL;
+	while (now_us < time)
+		wait_until(time);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	module_active = true;
+	uint64_t time = now_us + us;
+	while (now_us < time)
+		wait_until(time);
+}
+
+void yield()
+{
+	// background tasks of the core take no time here
+}
+
+void configTime(long timezone, int daylight, const char* server)
+{
+}
+
+int esp_host_gettimeofday(struct timeval* tv, void* tz)
+{
+	uint64_t time = epoch + now_us;
+	tv->tv_sec = (time_t)(time / 1000000);
+	tv->tv_usec = (suseconds_t)(time % 1000000);
+	return 0;
+}
+
+time_t esp_host_time(time_t* t)
+{
+	time_t time = (time_t)((epoch + now_us) / 1000000);
+	if (t)
+		*t = time;
+	return time;
+}
+
+
+static void dispatch_requests(void)
+{
+	// requests are gone shortly after their responses are sent
+	for (AsyncWebServerRequest* request : sent_requests)
+	{
+		if (request->disconnect_handler)
+			request->disconnect_handler();
+		delete request;
+	}
+	sent_requests.clear();
+
+	while (web_server && !incoming_requests.empty())
+	{
+		incoming_request_t incoming = incoming_requests.front();
+		incoming_requests.pop_front();
+		module_active = true;
+
+		AsyncWebServerRequest* request = new AsyncWebServerRequest;
+		request->id = incoming.id;
+		request->request_method = incoming.post ? HTTP_POST : HTTP_GET;
+
+		std::string path = incoming.uri.substr(0, incoming.uri.find('?'));
+		request->path = path;
+		if (path.size() < incoming.uri.size())
+		{
+			std::string query = incoming.uri.substr(path.size() + 1);
+			for (size_t position = 0; position <= query.size(); )
+			{
+				size_t end = query.find('&', position);
+				if (end == std::string::npos)
+					end = query.size();
+
+				std::string pair = query.substr(position, end - position);
+				size_t separator = pair.find('=');
+				request->args[pair.substr(0, separator)] = (separator == std::string::npos) ? "" : pair.substr(separator + 1);
+				position = end + 1;
+			}
+		}
+
+		for (size_t position = 0; position < incoming.headers.size(); )
+		{
+			size_t end = incoming.headers.find('\n', position);
+			if (end == std::string::npos)
+				end = incoming.headers.size();
+
+			std::string line = incoming.headers.substr(position, end - position);
+			size_t separator = line.find(':');
+			if (separator != std::string::npos)
+			{
+				std::string name = line.substr(0, separator);
+				size_t value = line.find_first_not_of(' ', separator + 1);
+				request->headers[name].reset(new AsyncWebHeader(name, (value == std::string::npos) ? "" : line.substr(value)));
+			}
+			position = end + 1;
+		}
+
+		auto route = web_server->routes.find(path);
+		if (route == web_server->routes.end() || !(route->second.method & request->request_method))
+		{
+			if (web_server->not_found)
+				web_server->not_found(request);
+			else
+				request->send(404, "text/plain", "Not found");
+			continue;
+		}
+
+		if (incoming.post && route->second.on_upload)
+		{
+			// upload is passed to the handler in chunks as the server receives it
+			size_t position = 0;
+			do
+			{
+				size_t length = std::min<size_t>(1460, incoming.data.size() - position);
+				route->second.on_upload(request, "firmware.bin", position, (uint8_t*)&incoming.data[position], length, position + length == incoming.data.size());
+				position += length;
+			}
+			while (position < incoming.data.size());
+		}
+
+		route->second.on_request(request);
+	}
+}
+
+void AsyncWebServer::on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction on_request, ArUploadHandlerFunction on_upload)
+{
+	routes[uri] = { method, on_request, on_upload };
+}
+
+void AsyncWebServer::begin()
+{
+	web_server = this;
+}
+
+const String& AsyncWebServerRequest::arg(const String& name) const
+{
+	static const String empty;
+	auto value = args.find(name);
+	return (value != args.end()) ? value->second : empty;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const
+{
+	auto header = headers.find(name);
+	return (header != headers.end()) ? header->second.get() : nullptr;
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String& content_type, const String& content)
+{
+	return new AsyncWebServerResponse(code, content_type, content);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String& content_type, const uint8_t* content, size_t len)
+{
+	return new AsyncWebServerResponse(code, content_type, std::string((const char*)content, len));
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginChunkedResponse(const String& content_type, AwsResponseFiller filler)
+{
+	return new AsyncChunkedResponse(content_type, filler);
+}
+
+AsyncResponseStream* AsyncWebServerRequest::beginResponseStream(const String& content_type, size_t buffer_size)
+{
+	return new AsyncResponseStream(content_type);
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse* response)
+{
+	if (!sent)
+	{
+		response_t& sent_response = responses[id];
+		sent_response.code = response->code;
+		sent_response.content = response->render();
+		sent_response.headers.clear();
+		if (!response->content_type.empty())
+			sent_response.headers = "Content-Type: " + response->content_type + "\n";
+		sent_response.headers += response->headers;
+
+		sent = true;
+		sent_requests.push_back(this);
+	}
+
+	delete response;
+}
+
+void AsyncWebServerRequest::redirect(const String& url)
+{
+	AsyncWebServerResponse* response = beginResponse(302);
+	response->addHeader("Location", url);
+	send(response);
+}
@@ -0,0 +1,46 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// host emulation of the remote module, remote.ino runs in its own context in lockstep with the simulated time
+// of the host program: it runs only inside esp_host_run() until it waits for the time (delays, time polling
+// or idle loop), so the whole emulation is deterministic
+
+#include <stdint.h>
+#include <string>
+
+void setup(void);
+void loop(void);
+
+// prepares the module context, setup() is called by the first esp_host_run()
+void esp_host_start(uint64_t epoch_us);
+
+// runs the module at the given simulated time (us) until it waits again
+void esp_host_run(uint64_t now);
+
+// simulated time the module waits for, it may be run sooner (a request has come)
+uint64_t esp_host_wake_time(void);
+
+// pin changes made by the module and reads of the pins, provided by the host program
+extern void (*esp_host_pin_changed)(uint8_t pin, bool output, bool level);
+extern bool (*esp_host_pin_read)(uint8_t pin);
+
+// web requests, GET with query string in the uri or POST when data are given (file upload for routes
+// taking it, empty otherwise), request and response headers are "name: value" lines; more requests may
+// be pending at once, the response is picked by the id of its request
+int esp_host_request(const std::string& uri, const std::string* data = nullptr, const std::string& headers = std::string());
+bool esp_host_response(int id, int* code, std::string* content, std::string* headers = nullptr);
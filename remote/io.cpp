@@ -29,6 +29,58 @@
 	const uint8_t PGD = 3;	// RX
 #endif
 
+// bit is clocked by a pulse on PGC, data are set up before the pulse and held after it
+static unsigned int bit_setup = 25;
+static unsigned int bit_pulse = 50;
+
+#ifdef IO_CAPTURE
+static io_event_t capture_events[IO_CAPTURE_EVENTS];
+static size_t capture_size = IO_CAPTURE_EVENTS;
+
+// levels of the signals as the capture has recorded them the last time
+static char capture_values[4];
+
+// PGD level and mode, the captured value combines them
+static bool data_level = LOW;
+static bool data_output = true;
+
+static void IRAM_ATTR capture(uint8_t signal, char value)
+{
+	if (capture_size == IO_CAPTURE_EVENTS || capture_values[signal] == value)
+		return;
+
+	capture_values[signal] = value;
+	capture_events[capture_size++] = { ESP.getCycleCount(), signal, value };
+}
+
+static char capture_data()
+{
+	return data_output ? (data_level ? '1' : '0') : 'z';
+}
+
+void io_captureStart()
+{
+	// the first events record the current levels
+	capture_size = 0;
+	memset(capture_values, 0, sizeof(capture_values));
+	capture(IO_RST, digitalRead(RST) ? '1' : '0');
+	capture(IO_PGC, digitalRead(PGC) ? '0' : '1');
+	capture(IO_PGD, capture_data());
+}
+
+size_t io_captureSize()
+{
+	return capture_size;
+}
+
+const io_event_t& io_captureEvent(size_t index)
+{
+	return capture_events[index];
+}
+#else
+#define capture(signal, value)
+#endif
+
 void io_init()
 {
 	pinMode(RST, OUTPUT);
@@ -43,46 +95,64 @@ void io_init()
 void io_reset(bool level)
 {
 	digitalWrite(RST, level);
+	capture(IO_RST, level ? '1' : '0');
 }
 
 void io_clock(bool level)
 {
 	digitalWrite(PGC, !level);
+	capture(IO_PGC, level ? '1' : '0');
 }
 
 void io_data(bool level)
 {
 	digitalWrite(PGD, !level);
+#ifdef IO_CAPTURE
+	data_level = level;
+	capture(IO_PGD, capture_data());
+#endif
 }
 bool io_data()
 {
-	return !digitalRead(PGD);
+	bool level = !digitalRead(PGD);
+	capture(IO_PGD_IN, level ? '1' : '0');
+	return level;
 }
 
 void io_mode(int mode)
 {
 	pinMode(PGD, mode);
+#ifdef IO_CAPTURE
+	data_output = (mode == OUTPUT);
+	capture(IO_PGD, capture_data());
+#endif
+}
+
+void io_bitTiming(unsigned int setup, unsigned int pulse)
+{
+	bit_setup = setup;
+	bit_pulse = pulse;
 }
 
 bool io_receiveBit()
 {
-	delayMicroseconds(25);
+	delayMicroseconds(bit_setup);
 	io_clock(HIGH);
-	delayMicroseconds(50);
+	delayMicroseconds(bit_pulse);
 	bool value = io_data();
 	io_clock(LOW);
-	delayMicroseconds(25);
+	delayMicroseconds(bit_setup);
 	return value;
 }
 
 void io_emitBit(bool value)
 {
 	io_data(value);
-	delayMicroseconds(25);
+	delayMicroseconds(bit_setup);
 	io_clock(HIGH);
-	delayMicroseconds(50);
+	delayMicroseconds(bit_pulse);
 	io_clock(LOW);
-	delayMicroseconds(25);
+	delayMicroseconds(bit_setup);
 }
 
 void io_emitPulse(unsigned int high, unsigned int low)
@@ -16,6 +16,29 @@
 
 #pragma once
 
+// uncomment to capture transitions of RST, PGC and PGD made and seen by the module, they are served
+// as VCD waveform by /capture.vcd (the buffer takes 8kB of RAM)
+//#define IO_CAPTURE
+
+#ifdef IO_CAPTURE
+#define IO_CAPTURE_EVENTS 1024
+
+enum io_signal_t
+{
+	IO_RST,
+	IO_PGC,
+	IO_PGD, // driven by the module, 'z' in input mode
+	IO_PGD_IN // PGD level read by the module, recorded when it's read
+};
+
+struct io_event_t
+{
+	uint32_t cycles; // CPU cycle counter
+	uint8_t signal;
+	char value; // '0', '1' or 'z'
+};
+#endif
+
 void io_init();
 
 void io_reset(bool level);
@@ -27,6 +50,14 @@ void io_clock(bool level);
 
 void io_mode(int mode);
 
+void io_bitTiming(unsigned int setup, unsigned int pulse);
 bool io_receiveBit();
 void io_emitBit(bool value);
 void io_emitPulse(unsigned int high, unsigned int low);
+
+#ifdef IO_CAPTURE
+// starts a new capture, it stops when the buffer is full
+void io_captureStart();
+size_t io_captureSize();
+const io_event_t& io_captureEvent(size_t index);
+#endif
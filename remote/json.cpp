@@ -0,0 +1,164 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+#include "json.h"
+
+static void put(json_t& json, const char* text, size_t length)
+{
+	// one byte is kept for the terminating zero
+	if (json.overflow || json.length + length >= json.size)
+	{
+		json.overflow = true;
+		return;
+	}
+
+	memcpy(json.buffer + json.length, text, length);
+	json.length += length;
+	json.buffer[json.length] = 0;
+}
+
+static void put(json_t& json, const char* text)
+{
+	put(json, text, strlen(text));
+}
+
+static void put_string(json_t& json, const char* text)
+{
+	put(json, "\"", 1);
+
+	// runs of plain characters are copied at once
+	const char* run = text;
+	for (; *text; ++text)
+	{
+		char c = *text;
+		if (c != '"' && c != '\\' && uint8_t(c) >= 0x20)
+			continue;
+
+		put(json, run, text - run);
+		run = text + 1;
+
+		char escape[8];
+		if (c == '"' || c == '\\')
+			sprintf(escape, "\\%c", c);
+		else
+			sprintf(escape, "\\u%04x", uint8_t(c));
+		put(json, escape);
+	}
+	put(json, run, text - run);
+
+	put(json, "\"", 1);
+}
+
+static void put_key(json_t& json, const char* key)
+{
+	if (json.separator)
+		put(json, ",", 1);
+	json.separator = true;
+
+	if (key)
+	{
+		put_string(json, key);
+		put(json, ":", 1);
+	}
+}
+
+void json_begin(json_t& json, char* buffer, size_t size)
+{
+	json.buffer = buffer;
+	json.size = size;
+	json.length = 0;
+	json.separator = false;
+	json.overflow = (size == 0);
+
+	if (size)
+		buffer[0] = 0;
+}
+
+size_t json_end(json_t& json)
+{
+	return json.overflow ? 0 : json.length;
+}
+
+void json_object(json_t& json, const char* key)
+{
+	put_key(json, key);
+	put(json, "{", 1);
+	json.separator = false;
+}
+
+void json_objectEnd(json_t& json)
+{
+	put(json, "}", 1);
+	json.separator = true;
+}
+
+void json_array(json_t& json, const char* key)
+{
+	put_key(json, key);
+	put(json, "[", 1);
+	json.separator = false;
+}
+
+void json_arrayEnd(json_t& json)
+{
+	put(json, "]", 1);
+	json.separator = true;
+}
+
+void json_null(json_t& json, const char* key)
+{
+	put_key(json, key);
+	put(json, "null", 4);
+}
+
+void json_bool(json_t& json, const char* key, bool value)
+{
+	put_key(json, key);
+	put(json, value ? "true" : "false");
+}
+
+void json_number(json_t& json, const char* key, long value)
+{
+	put_key(json, key);
+
+	char text[12];
+	put(json, text, sprintf(text, "%ld", value));
+}
+
+void json_fixed(json_t& json, const char* key, long value, unsigned int decimals)
+{
+	put_key(json, key);
+
+	// value is in units of the last decimal place
+	unsigned long scale = 1;
+	for (unsigned int n = 0; n < decimals; ++n)
+		scale *= 10;
+
+	unsigned long magnitude = (value < 0) ? 0UL - (unsigned long)value : (unsigned long)value;
+
+	char text[24];
+	if (decimals)
+		put(json, text, sprintf(text, "%s%lu.%0*lu", (value < 0) ? "-" : "", magnitude / scale, int(decimals), magnitude % scale));
+	else
+		put(json, text, sprintf(text, "%ld", value));
+}
+
+void json_string(json_t& json, const char* key, const char* value)
+{
+	put_key(json, key);
+	put_string(json, value);
+}
@@ -0,0 +1,44 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// JSON writer serializing straight into the given buffer, values are separated and keys quoted by it,
+// nothing is written past the buffer end and json_end() reports it then
+
+struct json_t
+{
+	char* buffer;
+	size_t size;
+	size_t length;
+	bool separator; // comma goes before the next value
+	bool overflow;
+};
+
+void json_begin(json_t& json, char* buffer, size_t size);
+size_t json_end(json_t& json); // length of the text, 0 when it didn't fit
+
+// key is nullptr inside arrays and for the top level value
+void json_object(json_t& json, const char* key = nullptr);
+void json_objectEnd(json_t& json);
+void json_array(json_t& json, const char* key = nullptr);
+void json_arrayEnd(json_t& json);
+
+void json_null(json_t& json, const char* key);
+void json_bool(json_t& json, const char* key, bool value);
+void json_number(json_t& json, const char* key, long value);
+void json_fixed(json_t& json, const char* key, long value, unsigned int decimals);
+void json_string(json_t& json, const char* key, const char* value);
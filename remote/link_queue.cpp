@@ -0,0 +1,47 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+#include "link_queue.h"
+
+// jobs wait in a ring, the first one runs next
+static link_job_t jobs[LINK_QUEUE_SIZE];
+static size_t jobs_first = 0;
+static size_t jobs_count = 0;
+
+bool link_queue(link_job_t job)
+{
+	if (jobs_count == LINK_QUEUE_SIZE)
+		return false;
+
+	jobs[(jobs_first + jobs_count) % LINK_QUEUE_SIZE] = job;
+	jobs_count++;
+	return true;
+}
+
+void link_run()
+{
+	if (jobs_count == 0)
+		return;
+
+	// job is taken off the queue before it runs, so it may queue another one
+	link_job_t job = std::move(jobs[jobs_first]);
+	jobs[jobs_first] = nullptr;
+	jobs_first = (jobs_first + 1) % LINK_QUEUE_SIZE;
+	jobs_count--;
+
+	job();
+}
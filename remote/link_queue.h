@@ -0,0 +1,30 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+
+// all transfers with the unit go through this queue, so requests served concurrently by the web server never
+// interleave on the wire; jobs are added by network callbacks and run one by one from loop(), callbacks don't
+// preempt loop() so no locking is needed
+
+#define LINK_QUEUE_SIZE 16
+
+typedef std::function<void()> link_job_t;
+
+bool link_queue(link_job_t job); // false when the queue is full
+void link_run();
@@ -18,6 +18,12 @@
 #include "packet.h"
 #include "io.h"
 
+// measured duration of a single byte transfer in us, initial value is the nominal bit timing
+static unsigned long byte_time = 800;
+
+// reason of the last failed transfer
+static packet_error_t last_error = PACKET_OK;
+
 uint8_t IRAM_ATTR crc_update(uint8_t crc, uint8_t data)
 {
 	// CRC-8-Dallas/Maxim
@@ -84,13 +90,16 @@ bool wait_data(bool state, unsigned long timeout)
 	return !timed_out;
 }
 
-bool packet_send(const uint8_t* data, size_t dataSize)
+bool packet_send_begin()
 {
 	io_mode(INPUT);
 
 	// PGD must be LOW before transmission, wait no more than 1ms
 	if (!wait_data(LOW, 1000))
+	{
+		last_error = PACKET_BUSY;
 		return false;
+	}
 
 	// set PGC to HIGH to signalize that data will be sent
 	io_clock(HIGH);
@@ -107,7 +116,18 @@ bool packet_send(const uint8_t* data, size_t dataSize)
 
 	// wait for PGD signal from remote unit timed out
 	if (timed_out)
+	{
+		last_error = PACKET_TIMEOUT;
 		return false;
+	}
+
+	last_error = PACKET_OK;
+	return true;
+}
+
+bool packet_send_data(const uint8_t* data, size_t dataSize)
+{
+	unsigned long transfer_start = micros();
 
 	// send the data
 	uint8_t crc = 0;
@@ -123,16 +143,32 @@ bool packet_send(const uint8_t* data, size_t dataSize)
 	// reset data back to LOW in case when last transmitted bit was 1
 	io_data(LOW);
 
+	byte_time = (micros() - transfer_start) / (dataSize + 1);
+
 	return true;
 }
 
+bool packet_send(const uint8_t* data, size_t dataSize)
+{
+	return packet_send_begin() && packet_send_data(data, dataSize);
+}
+
+unsigned long packet_transfer_time(size_t dataSize)
+{
+	// data are followed by CRC byte
+	return byte_time * (dataSize + 1);
+}
+
 bool packet_receive(uint8_t* data, size_t dataSize)
 {
 	io_mode(INPUT);
 
 	// PGD must be HIGH before transmission, wait no more than 1ms
 	if (!wait_data(HIGH, 1000))
+	{
+		last_error = PACKET_BUSY;
 		return false;
+	}
 
 	// set PGC to HIGH to signalize that data can be received
 	io_clock(HIGH);
@@ -144,12 +180,18 @@ bool packet_receive(uint8_t* data, size_t dataSize)
 	io_clock(LOW);
 
 	if (timed_out)
+	{
+		last_error = PACKET_TIMEOUT;
 		return false;
+	}
 
 	// receive size of the data
 	uint8_t data_size = receive_byte();
 	if (data_size != dataSize)
+	{
+		last_error = PACKET_SIZE;
 		return false;
+	}
 
 	// receive the data
 	uint8_t crc = 0;
@@ -161,7 +203,16 @@ bool packet_receive(uint8_t* data, size_t dataSize)
 
 	// receive and check data CRC
 	if (receive_byte() != crc)
+	{
+		last_error = PACKET_CRC;
 		return false;
+	}
 
+	last_error = PACKET_OK;
 	return true;
 }
+
+packet_error_t packet_error()
+{
+	return last_error;
+}
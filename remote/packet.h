@@ -16,5 +16,18 @@
 
 #pragma once
 
+enum packet_error_t
+{
+	PACKET_OK,
+	PACKET_BUSY, // PGD wasn't idle before the transfer
+	PACKET_TIMEOUT, // remote unit didn't answer the handshake
+	PACKET_SIZE, // received size doesn't match the expected one
+	PACKET_CRC
+};
+
 bool packet_send(const uint8_t* data, size_t dataSize);
+bool packet_send_begin();
+bool packet_send_data(const uint8_t* data, size_t dataSize);
+unsigned long packet_transfer_time(size_t dataSize);
 bool packet_receive(uint8_t* data, size_t dataSize);
+packet_error_t packet_error();
@@ -0,0 +1,151 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+#include "page.h"
+
+struct page_state_t
+{
+	PGM_P position;
+	page_placeholder_t placeholder;
+
+	// value of the last placeholder goes out before the rest of the template
+	char value[PAGE_VALUE_SIZE];
+	size_t value_length;
+	size_t value_sent;
+};
+
+// response whose placeholder is being written
+static page_state_t* page_state = nullptr;
+
+static bool name_char(char c)
+{
+	return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// length of __NAME__ placeholder at the position, 0 when there's none
+static size_t placeholder_name(PGM_P position, char* name, size_t name_size)
+{
+	if (pgm_read_byte(position) != '_' || pgm_read_byte(position + 1) != '_')
+		return 0;
+
+	// name ends by the next double underscore
+	size_t length = 0;
+	PGM_P end = position + 2;
+	for (char n; length < name_size - 1 && name_char(n = pgm_read_byte(end)); ++end)
+	{
+		if (n == '_' && pgm_read_byte(end + 1) == '_')
+			break;
+		name[length++] = n;
+	}
+
+	if (length == 0 || pgm_read_byte(end) != '_' || pgm_read_byte(end + 1) != '_')
+		return 0;
+
+	name[length] = 0;
+	return end + 2 - position;
+}
+
+static size_t fill(page_state_t& state, uint8_t* buffer, size_t size)
+{
+	size_t length = 0;
+	while (length < size)
+	{
+		if (state.value_sent < state.value_length)
+		{
+			size_t part = std::min(size - length, state.value_length - state.value_sent);
+			memcpy(buffer + length, state.value + state.value_sent, part);
+			state.value_sent += part;
+			length += part;
+			continue;
+		}
+
+		char name[32];
+		size_t placeholder_length = placeholder_name(state.position, name, sizeof(name));
+		if (placeholder_length)
+		{
+			state.value_length = 0;
+			state.value_sent = 0;
+
+			page_state = &state;
+			state.placeholder(name);
+			page_state = nullptr;
+
+			state.position += placeholder_length;
+			continue;
+		}
+
+		// template is copied in runs up to the next underscore
+		size_t run = 0;
+		for (char c; length + run < size && (c = pgm_read_byte(state.position + run)) != 0; ++run)
+		{
+			if (c == '_' && run != 0)
+				break;
+		}
+
+		if (run == 0)
+			// end of the page
+			break;
+
+		memcpy_P(buffer + length, state.position, run);
+		state.position += run;
+		length += run;
+	}
+
+	return length;
+}
+
+AsyncWebServerResponse* page_response(AsyncWebServerRequest* request, PGM_P page, page_placeholder_t placeholder)
+{
+	std::shared_ptr<page_state_t> state = std::make_shared<page_state_t>();
+	state->position = page;
+	state->placeholder = placeholder;
+	state->value_length = 0;
+	state->value_sent = 0;
+
+	return request->beginChunkedResponse("text/html", [state](uint8_t* buffer, size_t max_len, size_t index) -> size_t
+	{
+		return fill(*state, buffer, max_len);
+	});
+}
+
+void page_write(const char* text, size_t size)
+{
+	if (!page_state)
+		return;
+
+	size_t length = std::min(size, sizeof(page_state->value) - page_state->value_length);
+	memcpy(page_state->value + page_state->value_length, text, length);
+	page_state->value_length += length;
+}
+
+void page_print(const char* text)
+{
+	page_write(text, strlen(text));
+}
+
+void page_printf(const char* format, ...)
+{
+	char text[128];
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	if (length > 0)
+		page_write(text, std::min(size_t(length), sizeof(text) - 1));
+}
@@ -0,0 +1,35 @@
+/*
+   https://github.com/gashtaan/hunter-xcore-firmware
+
+   Copyright (C) 2021, Michal Kovacik
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License version 3, as
+   published by the Free Software Foundation.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <functional>
+
+// HTML page template stays in flash, it's streamed by chunked response as the TCP stack takes it and
+// each __NAME__ placeholder in it is replaced by whatever its callback writes at that place
+
+#define PAGE_VALUE_SIZE 768
+
+typedef std::function<void(const char* name)> page_placeholder_t;
+
+// placeholders are filled in while the response is sent, so the callback keeps its data with it
+AsyncWebServerResponse* page_response(AsyncWebServerRequest* request, PGM_P page, page_placeholder_t placeholder);
+
+// output of the placeholders, a value longer than PAGE_VALUE_SIZE is cut
+void page_write(const char* text, size_t size);
+void page_print(const char* text);
+void page_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
@@ -14,24 +14,97 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-//#define DEBUG_ESP_HTTP_SERVER
-
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
-#include <NTPClient.h>
-#include <WiFiUdp.h>
+#include <ESPAsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#include <time.h>
+#include <sys/time.h>
+#include <vector>
 #include <ArduinoOTA.h>
 #include "io.h"
 #include "packet.h"
 #include "firmware.h"
+#include "json.h"
+#include "link_queue.h"
+#include "page.h"
+#include "web_assets.h"
 
 IPAddress ip(192, 168, 1, 19);
 IPAddress gateway(192, 168, 1, 1);
 IPAddress subnet(255, 255, 255, 0);
 IPAddress dns(192, 168, 1, 1);
 
-ESP8266WebServer web_server(80);
+AsyncWebServer web_server(80);
+
+// unit time zone offset in seconds
+const long time_offset = 7200;
+
+// RTCC calibration step of the unit in ppm, 4 clock pulses of 32768Hz crystal every minute
+const float calibration_step = 4.0f / (32768.0f * 60.0f) * 1e6f;
+
+// unit clock offset against the system time when it was synced or measured the last time (in us)
+static int64_t sync_time = 0;
+static int64_t sync_offset = 0;
+
+// unit info answered to 0xB1 request
+struct unit_info_t
+{
+	struct
+	{
+		uint8_t day;
+		uint8_t month;
+		uint8_t year;
+		uint8_t hours;
+		uint8_t minutes;
+	}
+	datetime;
+
+	uint8_t seasonal_adjustment;
+	uint16_t stations[8];
+
+	struct
+	{
+		uint16_t frequency;
+		uint16_t missing_cycles;
+		uint16_t dropouts;
+	}
+	mains;
+};
+
+// program answered to 0xB5 request
+struct unit_program_t
+{
+	uint8_t hour; // 24 means OFF
+	uint8_t minute;
+	uint8_t calendar;
+	uint8_t run_times[8];
+};
+
+// unit data read by the API are kept for a while, so polling doesn't cost a transfer every time,
+// commands sent to the unit make them out of date
+struct unit_read_t
+{
+	bool known;
+	bool valid;
+	unsigned long read_ms;
+};
+
+const unsigned long unit_info_max_age = 1000;
+const unsigned long unit_programs_max_age = 10000;
+
+static unit_info_t api_unit_info;
+static unit_read_t api_unit_info_read;
+static unit_program_t api_programs[8];
+static unit_read_t api_programs_read[8];
+
+// API responses are tagged by the version of the unit state, it changes whenever data read from the unit
+// differ from the ones read before, so pollers get cheap 304 until something really changes
+static uint32_t state_version = 0;
+static time_t state_time = 0;
+
+// API responses are serialized straight into this buffer
+static char api_buffer[1536];
 
 void updateUnitTime();
 
@@ -55,6 +128,9 @@ void setup(void)
 	while (WiFi.status() != WL_CONNECTED)
 		delay(1000);
 
+	// system time is kept in sync by SNTP in background
+	configTime(0, 0, "europe.pool.ntp.org");
+
 	updateUnitTime();
 
 	ArduinoOTA.begin();
@@ -65,7 +141,25 @@ void setup(void)
 	web_server.on("/stopStations", web_stopStations);
 	web_server.on("/seasonalAdjustment", web_seasonalAdjustment);
 	web_server.on("/updateTime", web_updateTime);
-	web_server.on("/uploadFirmware", HTTP_POST, [](){ web_server.send(200); }, web_uploadFirmware);
+	web_server.on("/diagnostics", web_diagnostics);
+	for (const web_asset_t& asset : web_assets)
+		web_server.on(asset.uri, HTTP_GET, web_asset);
+#ifdef IO_CAPTURE
+	web_server.on("/capture", web_capture);
+	web_server.on("/capture.vcd", web_captureVcd);
+#endif
+	web_server.on("/uploadFirmware", HTTP_POST, web_uploadFirmware, web_uploadFirmwareData);
+
+	web_server.on("/api/v1/status", HTTP_GET, web_apiStatus);
+	web_server.on("/api/v1/stations", HTTP_GET, web_apiStations);
+	web_server.on("/api/v1/programs", HTTP_GET, web_apiPrograms);
+	web_server.on("/api/v1/time", HTTP_GET, web_apiTime);
+	web_server.on("/api/v1/programs/start", HTTP_POST, web_apiStartProgram);
+	web_server.on("/api/v1/stations/start", HTTP_POST, web_apiStartStations);
+	web_server.on("/api/v1/stations/stop", HTTP_POST, web_apiStopStations);
+	web_server.on("/api/v1/seasonalAdjustment", HTTP_POST, web_apiSeasonalAdjustment);
+	web_server.on("/api/v1/time/update", HTTP_POST, web_apiUpdateTime);
+
 	web_server.begin();
 }
 
@@ -77,260 +171,1099 @@ void loop(void)
 	{
 		ms = millis();
 
-		uint8_t packet[] = { 0xBB };
-		packet_send(packet, sizeof(packet));
+		link_queue([]()
+		{
+			uint8_t packet[] = { 0xBB };
+			packet_send(packet, sizeof(packet));
+		});
+	}
+
+	// sync unit time every 6 hours, the unit clock drift is measured and calibrated meanwhile
+	static unsigned long sync_ms = 0;
+	if ((millis() - sync_ms) > 6 * 3600000UL)
+	{
+		sync_ms = millis();
+
+		link_queue(updateUnitTime);
 	}
 
 	ArduinoOTA.handle();
 
-	web_server.handleClient();
-}
-
-void web_mainPage()
-{
-	String html = R"HTML(
-		<html>
-		<title>Hunter X-Core Remote</title>
-		<meta name="viewport" content="width=device-width">
-		<body>
-			RSSI: __RSSI__ dBm<br>
-			<hr>
-			Start program:<br>
-			<form method="get" action="/startProgram">
-				<select name="program">
-					<option value="0">1</option>
-					<option value="1">2</option>
-					<option value="2">3</option>
-					<option value="3">4</option>
-					<option value="4">5</option>
-					<option value="5">6</option>
-					<option value="6">7</option>
-					<option value="7">8</option>
-				</select>
-				<input type="submit" value="Start">
-			</form>
-
-			Start stations:<br>
-			<form method="get" action="/startStations">
-				1: <input type="text" name="station_1" size="3"> __UNIT_STATION_1__<br>
-				2: <input type="text" name="station_2" size="3"> __UNIT_STATION_2__<br>
-				3: <input type="text" name="station_3" size="3"> __UNIT_STATION_3__<br>
-				4: <input type="text" name="station_4" size="3"> __UNIT_STATION_4__<br>
-				5: <input type="text" name="station_5" size="3"> __UNIT_STATION_5__<br>
-				6: <input type="text" name="station_6" size="3"> __UNIT_STATION_6__<br>
-				7: <input type="text" name="station_7" size="3"> __UNIT_STATION_7__<br>
-				8: <input type="text" name="station_8" size="3"> __UNIT_STATION_8__<br>
-				<input type="submit" value="Start">
-			</form>
-
-			<form method="get" action="/stopStations">
-				<input type="submit" value="Stop">
-			</form>
-			<hr>
-			Seasonal adjustment:<br>
-			<form method="get" action="/seasonalAdjustment">
-				<input type="text" name="adjustment" size="3" value="__UNIT_SA__">
-				<input type="submit" value="Change">
-			</form>
-			<hr>
-			<form method="get" action="/updateTime">
-				Unit time:<br>
-				__UNIT_TIME__<br>
-				<input type="submit" value="Update Time">
-			</form>
-			<hr>
-			Upload Firmware:<br>
-			<form method="post" action="/uploadFirmware" enctype="multipart/form-data">
-				<input type="file" name="data"><br>
-				<input type="submit" value="Upload">
-			</form>
-		</body>
-		</html>
-	)HTML";
+	// one job per loop, so OTA and the network get their turn between transfers
+	link_run();
+}
 
-	struct
+// pages stay in flash, their placeholders are filled in while they are streamed
+static const char main_page[] PROGMEM = R"HTML(
+<html>
+<title>Hunter X-Core Remote</title>
+<meta name="viewport" content="width=device-width">
+<link rel="stylesheet" href="/style.css">
+<body>
+	RSSI: __RSSI__ dBm<br>
+	<hr>
+	Start program:<br>
+	<form method="get" action="/startProgram">
+		<select name="program">
+			<option value="0">1</option>
+			<option value="1">2</option>
+			<option value="2">3</option>
+			<option value="3">4</option>
+			<option value="4">5</option>
+			<option value="5">6</option>
+			<option value="6">7</option>
+			<option value="7">8</option>
+		</select>
+		<input type="submit" value="Start">
+	</form>
+
+	Start stations:<br>
+	<form method="get" action="/startStations">
+		1: <input type="text" name="station_1" size="3"> __UNIT_STATION_1__<br>
+		2: <input type="text" name="station_2" size="3"> __UNIT_STATION_2__<br>
+		3: <input type="text" name="station_3" size="3"> __UNIT_STATION_3__<br>
+		4: <input type="text" name="station_4" size="3"> __UNIT_STATION_4__<br>
+		5: <input type="text" name="station_5" size="3"> __UNIT_STATION_5__<br>
+		6: <input type="text" name="station_6" size="3"> __UNIT_STATION_6__<br>
+		7: <input type="text" name="station_7" size="3"> __UNIT_STATION_7__<br>
+		8: <input type="text" name="station_8" size="3"> __UNIT_STATION_8__<br>
+		<input type="submit" value="Start">
+	</form>
+
+	<form method="get" action="/stopStations">
+		<input type="submit" value="Stop">
+	</form>
+	<hr>
+	Seasonal adjustment:<br>
+	<form method="get" action="/seasonalAdjustment">
+		<input type="text" name="adjustment" size="3" value="__UNIT_SA__">
+		<input type="submit" value="Change">
+	</form>
+	<hr>
+	Mains: __UNIT_MAINS__<br>
+	<hr>
+	<form method="get" action="/updateTime">
+		Unit time:<br>
+		__UNIT_TIME__<br>
+		<input type="submit" value="Update Time">
+	</form>
+	<hr>
+	Upload Firmware:<br>
+	<form method="post" action="/uploadFirmware" enctype="multipart/form-data">
+		<input type="file" name="data"><br>
+		<input type="submit" value="Upload">
+	</form>
+	<hr>
+	<a href="/diagnostics">Diagnostics</a>
+</body>
+</html>
+)HTML";
+
+static const char diagnostics_page[] PROGMEM = R"HTML(
+<html>
+<title>Hunter X-Core Remote - Diagnostics</title>
+<meta name="viewport" content="width=device-width">
+<link rel="stylesheet" href="/style.css">
+<body>
+	Scheduler:<br>
+	__SCHEDULER__
+	<hr>
+	Profiler:<br>
+	__PROFILER__
+	<form method="get" action="/diagnostics">
+		<input type="hidden" name="reset" value="1">
+		<input type="submit" value="Reset">
+	</form>
+	__CAPTURE__
+	<hr>
+	<a href="/">Back</a>
+</body>
+</html>
+)HTML";
+
+// request is answered by its job when the link gets to it, the job gets nullptr when the client has gone
+// meanwhile, it still does what was asked then, only the answer is dropped
+static bool queueRequest(AsyncWebServerRequest* request, std::function<void(AsyncWebServerRequest* request)> job)
+{
+	std::shared_ptr<bool> connected = std::make_shared<bool>(true);
+	request->onDisconnect([connected]()
+	{
+		*connected = false;
+	});
+
+	return link_queue([request, connected, job]()
 	{
-		struct
+		job(*connected ? request : nullptr);
+	});
+}
+
+static void pageRequest(AsyncWebServerRequest* request, std::function<void(AsyncWebServerRequest* request)> job)
+{
+	if (!queueRequest(request, job))
+		request->send(503, "text/plain", "Busy");
+}
+
+// forms are answered by redirect, so reloading the page doesn't repeat them
+static void redirect(AsyncWebServerRequest* request, const char* location)
+{
+	AsyncWebServerResponse* response = request->beginResponse(303);
+	response->addHeader("Location", location);
+	request->send(response);
+}
+
+static void pageCommand(AsyncWebServerRequest* request, std::vector<uint8_t> packet)
+{
+	pageRequest(request, [packet](AsyncWebServerRequest* request)
+	{
+		sendCommand(packet.data(), packet.size());
+		if (request)
+			redirect(request, "/");
+	});
+}
+
+void web_mainPage(AsyncWebServerRequest* request)
+{
+	pageRequest(request, [](AsyncWebServerRequest* request)
+	{
+		// unit info goes with the response, placeholders are filled in as it's sent
+		std::shared_ptr<unit_info_t> unit_info = std::make_shared<unit_info_t>();
+
+		uint8_t packet[] = { 0xB1 };
+		bool unit_info_read = packet_send(packet, sizeof(packet)) && packet_receive((uint8_t*)unit_info.get(), sizeof(unit_info_t));
+
+		if (!request)
+			return;
+
+		request->send(page_response(request, main_page, [unit_info, unit_info_read](const char* name)
 		{
-			uint8_t day;
-			uint8_t month;
-			uint8_t year;
-			uint8_t hours;
-			uint8_t minutes;
-		}
-		datetime;
+			if (strcmp(name, "RSSI") == 0)
+			{
+				page_printf("%d", int(WiFi.RSSI()));
+			}
+			else if (!unit_info_read)
+			{
+				if (strcmp(name, "UNIT_MAINS") == 0 || strcmp(name, "UNIT_TIME") == 0)
+					page_print("not available");
+			}
+			else if (strcmp(name, "UNIT_SA") == 0)
+			{
+				page_printf("%u", unit_info->seasonal_adjustment);
+			}
+			else if (strcmp(name, "UNIT_TIME") == 0)
+			{
+				const auto& dt = unit_info->datetime;
+				page_printf("%u.%u.20%u %02u:%02u", dt.day, dt.month, dt.year, dt.hours, dt.minutes);
+			}
+			else if (strncmp(name, "UNIT_STATION_", 13) == 0)
+			{
+				unsigned int station = atoi(name + 13) - 1;
+				uint16_t seconds = (station < 8) ? unit_info->stations[station] : 0;
+				if (seconds)
+					page_printf("%02u:%02u:%02u", seconds / 3600, seconds % 3600 / 60, seconds % 60);
+			}
+			else if (strcmp(name, "UNIT_MAINS") == 0)
+			{
+				const auto& mains = unit_info->mains;
+				page_printf("%u.%u Hz, missing cycles %u, dropouts %u", mains.frequency / 10, mains.frequency % 10, mains.missing_cycles, mains.dropouts);
+			}
+		}));
+	});
+}
 
-		uint8_t seasonal_adjustment;
-		uint16_t stations[8];
-	}
-	unit_info = {};
+void web_diagnostics(AsyncWebServerRequest* request)
+{
+	uint8_t reset = uint8_t(request->arg("reset") == "1");
 
-	uint8_t packet[] = { 0xB1 };
-	if (packet_send(packet, sizeof(packet)) && packet_receive((uint8_t*)&unit_info, sizeof(unit_info)))
+	pageRequest(request, [reset](AsyncWebServerRequest* request)
 	{
-		auto format_date = [](const auto& dt)
+		struct diagnostics_t
 		{
-			char str[20];
-			sprintf(str, "%u.%u.20%u %02u:%02u", dt.day, dt.month, dt.year, dt.hours, dt.minutes);
-			return String(str);
+			struct __attribute__((packed))
+			{
+				uint16_t frame_time_max;
+				uint8_t frame_overruns;
+				struct __attribute__((packed))
+				{
+					uint8_t late_max;
+					uint8_t overruns;
+				}
+				tasks[8];
+			}
+			scheduler_stats;
+			bool scheduler_read;
+
+			struct __attribute__((packed))
+			{
+				uint8_t tick_cycles;
+				struct __attribute__((packed))
+				{
+					uint16_t count;
+					uint16_t min;
+					uint16_t max;
+					uint32_t total;
+				}
+				regions[5];
+				uint16_t frame_overruns;
+			}
+			profiler_stats;
+			bool profiler_read;
 		};
-		auto format_time = [](uint16_t seconds)
+
+		// stats go with the response, placeholders are filled in as it's sent
+		std::shared_ptr<diagnostics_t> diagnostics = std::make_shared<diagnostics_t>();
+
+		uint8_t scheduler_packet[] = { 0xB2 };
+		diagnostics->scheduler_read = packet_send(scheduler_packet, sizeof(scheduler_packet)) && packet_receive((uint8_t*)&diagnostics->scheduler_stats, sizeof(diagnostics->scheduler_stats));
+
+		uint8_t profiler_packet[] = { 0xB4, reset };
+		diagnostics->profiler_read = packet_send(profiler_packet, sizeof(profiler_packet)) && packet_receive((uint8_t*)&diagnostics->profiler_stats, sizeof(diagnostics->profiler_stats));
+
+		if (!request)
+			return;
+
+		request->send(page_response(request, diagnostics_page, [diagnostics](const char* name)
 		{
-			if (seconds == 0)
-				return String();
+			const auto& scheduler_stats = diagnostics->scheduler_stats;
+			const auto& profiler_stats = diagnostics->profiler_stats;
 
-			char str[10];
-			sprintf(str, "%02u:%02u:%02u", seconds / 3600, seconds % 3600 / 60, seconds % 60);
-			return String(str);
-		};
-		html.replace("__UNIT_SA__", String(unit_info.seasonal_adjustment));
-		html.replace("__UNIT_TIME__", format_date(unit_info.datetime));
-		html.replace("__UNIT_STATION_1__", format_time(unit_info.stations[0]));
-		html.replace("__UNIT_STATION_2__", format_time(unit_info.stations[1]));
-		html.replace("__UNIT_STATION_3__", format_time(unit_info.stations[2]));
-		html.replace("__UNIT_STATION_4__", format_time(unit_info.stations[3]));
-		html.replace("__UNIT_STATION_5__", format_time(unit_info.stations[4]));
-		html.replace("__UNIT_STATION_6__", format_time(unit_info.stations[5]));
-		html.replace("__UNIT_STATION_7__", format_time(unit_info.stations[6]));
-		html.replace("__UNIT_STATION_8__", format_time(unit_info.stations[7]));
+			if (strcmp(name, "SCHEDULER") == 0)
+			{
+				if (!diagnostics->scheduler_read)
+				{
+					page_print("not available<br>");
+					return;
+				}
+
+				// tasks in order they are added to the unit's scheduler
+				const char* task_names[] = { "clock", "programs", "sensor", "power", "remote", "ui" };
+
+				// frame time is measured in 1/4096s ticks
+				page_printf("longest frame %lu ms, frame overruns %u<br>", (scheduler_stats.frame_time_max * 1000UL + 2048) / 4096, scheduler_stats.frame_overruns);
+
+				page_print("<table><tr><th>task</th><th>late max [frames]</th><th>overruns</th></tr>");
+				for (size_t n = 0; n < sizeof(task_names) / sizeof(task_names[0]); ++n)
+					page_printf("<tr><td>%s</td><td>%u</td><td>%u</td></tr>", task_names[n], scheduler_stats.tasks[n].late_max, scheduler_stats.tasks[n].overruns);
+				page_print("</table>");
+			}
+			else if (strcmp(name, "PROFILER") == 0)
+			{
+				if (!diagnostics->profiler_read)
+				{
+					page_print("not available (release build without PROFILER)<br>");
+					return;
+				}
+
+				// regions in order of the unit's profiler
+				const char* region_names[] = { "frame", "remote handle", "programs save", "sensor update", "display update" };
+
+				// durations are in timer ticks, unit's instruction cycle is 1us
+				page_printf("frame overruns %u<br>", profiler_stats.frame_overruns);
+
+				page_print("<table><tr><th>region</th><th>count</th><th>min [us]</th><th>avg [us]</th><th>max [us]</th></tr>");
+				for (size_t n = 0; n < sizeof(region_names) / sizeof(region_names[0]); ++n)
+				{
+					const auto& region = profiler_stats.regions[n];
+					if (region.count == 0)
+					{
+						page_printf("<tr><td>%s</td><td>0</td><td></td><td></td><td></td></tr>", region_names[n]);
+					}
+					else
+					{
+						unsigned long cycles = profiler_stats.tick_cycles;
+						page_printf("<tr><td>%s</td><td>%u</td><td>%lu</td><td>%lu</td><td>%lu</td></tr>", region_names[n], region.count,
+							region.min * cycles, region.total / region.count * cycles, region.max * cycles);
+					}
+				}
+				page_print("</table>");
+			}
+#ifdef IO_CAPTURE
+			else if (strcmp(name, "CAPTURE") == 0)
+			{
+				page_printf("<hr>Capture:<br>%u of %u events ", unsigned(io_captureSize()), unsigned(IO_CAPTURE_EVENTS));
+				page_print("<a href=\"/capture\">Start</a> <a href=\"/capture.vcd\">Download</a><br>");
+			}
+#endif
+		}));
+	});
+}
+
+void web_asset(AsyncWebServerRequest* request)
+{
+	// assets are sent gzipped as they are in flash, browsers keep them for a day
+	for (const web_asset_t& asset : web_assets)
+	{
+		if (request->url() != asset.uri)
+			continue;
+
+		AsyncWebServerResponse* response = request->beginResponse_P(200, asset.type, asset.data, asset.size);
+		response->addHeader("Content-Encoding", "gzip");
+		response->addHeader("Cache-Control", "max-age=86400");
+		request->send(response);
+		return;
 	}
 
-	html.replace("__RSSI__", String(WiFi.RSSI(), DEC));
+	request->send(404, "text/plain", "Not found");
+}
+
+#ifdef IO_CAPTURE
+void web_capture(AsyncWebServerRequest* request)
+{
+	io_captureStart();
 
-	web_server.send(200, "text/html", html);
+	redirect(request, "/diagnostics");
 }
 
-void web_startProgram()
+void web_captureVcd(AsyncWebServerRequest* request)
 {
-	uint8_t packet[] = {
-		0xA0,
-		uint8_t(web_server.arg("program").toInt())
+	static const char header[] PROGMEM =
+		"$timescale 100ns $end\n"
+		"$scope module module $end\n"
+		"$var wire 1 r rst $end\n"
+		"$var wire 1 c pgc $end\n"
+		"$var wire 1 d pgd $end\n"
+		"$var wire 1 i pgd_in $end\n"
+		"$upscope $end\n"
+		"$enddefinitions $end\n";
+
+	// events are converted as the TCP stack takes them, the header goes first
+	struct vcd_t
+	{
+		size_t header_sent;
+		size_t event;
+
+		// cycle counter wraps around in less than a minute, so the time is summed from the differences
+		uint64_t cycles;
+		uint32_t last_cycles;
+		unsigned long last_time;
 	};
-	packet_send(packet, sizeof(packet));
 
-	web_server.sendHeader("Location", "/");
-	web_server.send(303);
+	std::shared_ptr<vcd_t> vcd = std::make_shared<vcd_t>();
+	vcd->header_sent = 0;
+	vcd->event = 0;
+	vcd->cycles = 0;
+	vcd->last_cycles = io_captureSize() ? io_captureEvent(0).cycles : 0;
+	vcd->last_time = 0;
+
+	request->send(request->beginChunkedResponse("text/plain", [vcd](uint8_t* buffer, size_t max_len, size_t index) -> size_t
+	{
+		size_t length = std::min(max_len, sizeof(header) - 1 - vcd->header_sent);
+		memcpy_P(buffer, header + vcd->header_sent, length);
+		vcd->header_sent += length;
+
+		// identifiers in order of io_signal_t
+		const char ids[] = { 'r', 'c', 'd', 'i' };
+
+		for (; vcd->event < io_captureSize(); ++vcd->event)
+		{
+			const io_event_t& event = io_captureEvent(vcd->event);
+			uint64_t cycles = vcd->cycles + uint32_t(event.cycles - vcd->last_cycles);
+
+			char line[24];
+			int line_length = 0;
+			unsigned long time = (unsigned long)(cycles * 10 / ESP.getCpuFreqMHz());
+			if (vcd->event == 0 || time != vcd->last_time)
+				line_length = sprintf(line, "#%lu\n", time);
+			line_length += sprintf(line + line_length, "%c%c\n", event.value, ids[event.signal]);
+
+			// event goes whole into the next chunk when it doesn't fit
+			if (length + line_length > max_len)
+				break;
+
+			memcpy(buffer + length, line, line_length);
+			length += line_length;
+
+			vcd->cycles = cycles;
+			vcd->last_cycles = event.cycles;
+			vcd->last_time = time;
+		}
+
+		return length;
+	}));
 }
+#endif
 
-void web_startStations()
+void web_startProgram(AsyncWebServerRequest* request)
 {
-	uint8_t packet[] = {
-		0xA1,
-		uint8_t(web_server.arg("station_1").toInt()),
-		uint8_t(web_server.arg("station_2").toInt()),
-		uint8_t(web_server.arg("station_3").toInt()),
-		uint8_t(web_server.arg("station_4").toInt()),
-		uint8_t(web_server.arg("station_5").toInt()),
-		uint8_t(web_server.arg("station_6").toInt()),
-		uint8_t(web_server.arg("station_7").toInt()),
-		uint8_t(web_server.arg("station_8").toInt())
-	};
-	packet_send(packet, sizeof(packet));
+	pageCommand(request, {
+		0xA0,
+		uint8_t(request->arg("program").toInt())
+	});
+}
 
-	web_server.sendHeader("Location", "/");
-	web_server.send(303);
+void web_startStations(AsyncWebServerRequest* request)
+{
+	pageCommand(request, {
+		0xA1,
+		uint8_t(request->arg("station_1").toInt()),
+		uint8_t(request->arg("station_2").toInt()),
+		uint8_t(request->arg("station_3").toInt()),
+		uint8_t(request->arg("station_4").toInt()),
+		uint8_t(request->arg("station_5").toInt()),
+		uint8_t(request->arg("station_6").toInt()),
+		uint8_t(request->arg("station_7").toInt()),
+		uint8_t(request->arg("station_8").toInt())
+	});
 }
 
-void web_stopStations()
+void web_stopStations(AsyncWebServerRequest* request)
 {
-	uint8_t packet[] = {
+	pageCommand(request, {
 		0xA2
-	};
-	packet_send(packet, sizeof(packet));
-
-	web_server.sendHeader("Location", "/");
-	web_server.send(303);
+	});
 }
 
-void web_seasonalAdjustment()
+void web_seasonalAdjustment(AsyncWebServerRequest* request)
 {
-	uint8_t packet[] = {
+	pageCommand(request, {
 		0xA3,
-		uint8_t(web_server.arg("adjustment").toInt())
-	};
-	packet_send(packet, sizeof(packet));
+		uint8_t(request->arg("adjustment").toInt())
+	});
+}
 
-	web_server.sendHeader("Location", "/");
-	web_server.send(303);
+void web_updateTime(AsyncWebServerRequest* request)
+{
+	pageRequest(request, [](AsyncWebServerRequest* request)
+	{
+		updateUnitTime();
+
+		if (request)
+			redirect(request, "/");
+	});
 }
 
-void web_updateTime()
+bool sendCommand(const uint8_t* packet, size_t packetSize)
 {
-	updateUnitTime();
+	// command may change the unit state, it's read again by the next API request
+	api_unit_info_read.valid = false;
+	return packet_send(packet, packetSize);
+}
 
-	web_server.sendHeader("Location", "/");
-	web_server.send(303);
+static bool unitFresh(const unit_read_t& read, unsigned long max_age)
+{
+	return read.valid && (millis() - read.read_ms) < max_age;
 }
 
-void web_uploadFirmware()
+// data start with the unit state, measurements following it (from stateSize on) don't change the version
+static bool readUnit(const uint8_t* request, size_t requestSize, void* data, size_t dataSize, size_t stateSize, unit_read_t& read, unsigned long max_age)
 {
-	static uint8_t data[16384];
-	static size_t data_size;
-	static bool data_ok;
+	if (unitFresh(read, max_age))
+		return true;
 
-	HTTPUpload& upload = web_server.upload();
-	switch (upload.status)
+	// the largest packet the unit sends is 30 bytes
+	uint8_t received[32];
+	if (dataSize > sizeof(received) || !packet_send(request, requestSize) || !packet_receive(received, dataSize))
+		return false;
+
+	if (!read.known || memcmp(received, data, stateSize) != 0)
 	{
-		case UPLOAD_FILE_START:
-			data_size = 0;
-			data_ok = true;
-			break;
+		state_version++;
+		state_time = time(nullptr);
+	}
+	memcpy(data, received, dataSize);
 
-		case UPLOAD_FILE_WRITE:
-			if (data_size + upload.currentSize > sizeof(data))
-			{
-				// not enough space in data buffer
-				data_ok = false;
-				break;
-			}
+	read.known = true;
+	read.valid = true;
+	read.read_ms = millis();
+	return true;
+}
 
-			memcpy(data + data_size, upload.buf, upload.currentSize);
-			data_size += upload.currentSize;
-			break;
+static void apiVersion(char* etag, char* modified)
+{
+	sprintf(etag, "\"%lu\"", (unsigned long)state_version);
+	strftime(modified, 32, "%a, %d %b %Y %H:%M:%S GMT", gmtime(&state_time));
+}
 
-		case UPLOAD_FILE_END:
-			if (data_ok)
-			{
-				// signal remote unit to prepare, it's going to be reset
-				uint8_t packet[] = { 0xB0 };
-				packet_send(packet, sizeof(packet));
+// clients may keep versioned responses, but they have to ask whether they're still current
+static void apiVersionHeaders(AsyncWebServerResponse* response)
+{
+	char etag[16], modified[32];
+	apiVersion(etag, modified);
 
-				if (firmwareUpload(data, data_size))
-				{
-					web_server.sendHeader("Location", "/");
-					web_server.send(303);
-					break;
-				}
-			}
-			// fallthrough
+	response->addHeader("ETag", etag);
+	response->addHeader("Last-Modified", modified);
+	response->addHeader("Cache-Control", "no-cache");
+}
+
+static bool apiNotModified(AsyncWebServerRequest* request)
+{
+	char etag[16], modified[32];
+	apiVersion(etag, modified);
+
+	// ETag takes precedence, the date is compared just as the client got it
+	bool not_modified;
+	if (request->hasHeader("If-None-Match"))
+		not_modified = (request->getHeader("If-None-Match")->value() == etag);
+	else
+		not_modified = (request->hasHeader("If-Modified-Since") && request->getHeader("If-Modified-Since")->value() == modified);
+
+	if (!not_modified)
+		return false;
+
+	AsyncWebServerResponse* response = request->beginResponse(304);
+	apiVersionHeaders(response);
+	request->send(response);
+	return true;
+}
+
+static void apiSend(AsyncWebServerRequest* request, int code, json_t& json, void (*headers)(AsyncWebServerResponse* response) = nullptr)
+{
+	size_t length = json_end(json);
+	if (length == 0)
+	{
+		request->send(500, "application/json", "{\"ok\":false,\"error\":\"response too long\"}");
+		return;
+	}
+
+	AsyncResponseStream* response = request->beginResponseStream("application/json");
+	response->setCode(code);
+	response->write((const uint8_t*)api_buffer, length);
+	if (headers)
+		headers(response);
+	request->send(response);
+}
+
+static void apiError(AsyncWebServerRequest* request, int code, const char* error)
+{
+	json_t json;
+	json_begin(json, api_buffer, sizeof(api_buffer));
+	json_object(json);
+	json_bool(json, "ok", false);
+	json_string(json, "error", error);
+	json_objectEnd(json);
+	apiSend(request, code, json);
+}
+
+static void apiUnitError(AsyncWebServerRequest* request)
+{
+	switch (packet_error())
+	{
+		case PACKET_BUSY:
+			apiError(request, 503, "unit busy");
+			break;
+		case PACKET_TIMEOUT:
+			apiError(request, 503, "unit not responding");
+			break;
+		case PACKET_SIZE:
+			apiError(request, 502, "unit response size mismatch");
+			break;
 		default:
-			web_server.send(500, "text/plain", "Upload error!");
+			apiError(request, 502, "unit response corrupted");
 			break;
 	}
 }
 
-void updateUnitTime()
+static void apiOk(AsyncWebServerRequest* request)
+{
+	json_t json;
+	json_begin(json, api_buffer, sizeof(api_buffer));
+	json_object(json);
+	json_bool(json, "ok", true);
+	json_objectEnd(json);
+	apiSend(request, 200, json);
+}
+
+static void apiRequest(AsyncWebServerRequest* request, std::function<void(AsyncWebServerRequest* request)> job)
+{
+	if (!queueRequest(request, job))
+		apiError(request, 503, "link busy");
+}
+
+static void apiCommand(AsyncWebServerRequest* request, std::vector<uint8_t> packet)
+{
+	// unit info read from now on comes after the command
+	api_unit_info_read.valid = false;
+
+	apiRequest(request, [packet](AsyncWebServerRequest* request)
+	{
+		bool sent = sendCommand(packet.data(), packet.size());
+		if (!request)
+			return;
+
+		if (sent)
+			apiOk(request);
+		else
+			apiUnitError(request);
+	});
+}
+
+// fresh unit info is answered right away, otherwise it's read when the link gets to it
+static void apiUnitInfo(AsyncWebServerRequest* request, void (*respond)(AsyncWebServerRequest* request))
+{
+	if (unitFresh(api_unit_info_read, unit_info_max_age))
+	{
+		respond(request);
+		return;
+	}
+
+	apiRequest(request, [respond](AsyncWebServerRequest* request)
+	{
+		uint8_t packet[] = { 0xB1 };
+		bool read = readUnit(packet, sizeof(packet), &api_unit_info, sizeof(api_unit_info), offsetof(unit_info_t, mains), api_unit_info_read, unit_info_max_age);
+		if (!request)
+			return;
+
+		if (read)
+			respond(request);
+		else
+			apiUnitError(request);
+	});
+}
+
+static void apiStatus(AsyncWebServerRequest* request)
 {
-	WiFiUDP ntp_udp;
-	NTPClient ntp_client(ntp_udp, "europe.pool.ntp.org", 7200);
+	if (apiNotModified(request))
+		return;
+
+	const unit_info_t& info = api_unit_info;
+
+	// fields are checked by nobody but the unit, a broken one mustn't overflow the buffer
+	char time[24];
+	snprintf(time, sizeof(time), "20%02u-%02u-%02uT%02u:%02u", info.datetime.year, info.datetime.month, info.datetime.day, info.datetime.hours, info.datetime.minutes);
+
+	json_t json;
+	json_begin(json, api_buffer, sizeof(api_buffer));
+	json_object(json);
+	json_number(json, "version", state_version);
+	json_string(json, "time", time);
+	json_number(json, "seasonal_adjustment", info.seasonal_adjustment);
 
-	ntp_client.begin();
+	// remaining run times in seconds
+	json_array(json, "stations");
+	for (size_t n = 0; n < 8; ++n)
+		json_number(json, nullptr, info.stations[n]);
+	json_arrayEnd(json);
+
+	// mains are measured all the time, they're current as of the version only
+	json_object(json, "mains");
+	json_fixed(json, "frequency", info.mains.frequency, 1);
+	json_number(json, "missing_cycles", info.mains.missing_cycles);
+	json_number(json, "dropouts", info.mains.dropouts);
+	json_objectEnd(json);
+
+	json_objectEnd(json);
+	apiSend(request, 200, json, apiVersionHeaders);
+}
+
+void web_apiStatus(AsyncWebServerRequest* request)
+{
+	apiUnitInfo(request, apiStatus);
+}
 
-	if (ntp_client.update())
+static void apiStations(AsyncWebServerRequest* request)
+{
+	if (apiNotModified(request))
+		return;
+
+	json_t json;
+	json_begin(json, api_buffer, sizeof(api_buffer));
+	json_object(json);
+	json_number(json, "version", state_version);
+	json_array(json, "stations");
+	for (size_t n = 0; n < 8; ++n)
 	{
-		time_t ntp_time = ntp_client.getEpochTime();
-		tm* gm_time = gmtime(&ntp_time);
+		json_object(json);
+		json_number(json, "station", n + 1);
+		json_number(json, "remaining", api_unit_info.stations[n]);
+		json_objectEnd(json);
+	}
+	json_arrayEnd(json);
+	json_objectEnd(json);
+	apiSend(request, 200, json, apiVersionHeaders);
+}
 
-		uint8_t packet[] = {
-			0xA4,
-			uint8_t(gm_time->tm_year % 100),
-			uint8_t(gm_time->tm_mon + 1),
-			uint8_t(gm_time->tm_mday),
-			uint8_t(ntp_client.getHours()),
-			uint8_t(ntp_client.getMinutes())
+void web_apiStations(AsyncWebServerRequest* request)
+{
+	apiUnitInfo(request, apiStations);
+}
+
+static void apiPrograms(AsyncWebServerRequest* request)
+{
+	if (apiNotModified(request))
+		return;
+
+	// weekday mask starts with Monday
+	const char* weekdays[] = { "mo", "tu", "we", "th", "fr", "sa", "su" };
+
+	json_t json;
+	json_begin(json, api_buffer, sizeof(api_buffer));
+	json_object(json);
+	json_number(json, "version", state_version);
+	json_array(json, "programs");
+	for (uint8_t n = 0; n < 8; ++n)
+	{
+		const unit_program_t& program = api_programs[n];
+
+		json_object(json);
+		json_number(json, "program", n + 1);
+
+		if (program.hour < 24)
+		{
+			char start[8];
+			sprintf(start, "%02u:%02u", program.hour, program.minute);
+			json_string(json, "start", start);
+		}
+		else
+		{
+			json_null(json, "start");
+		}
+
+		// calendar is encoded as 0XXXXXXX weekday mask, 10XXXYYY every X+1 days with offset Y, 110X0000 odd/even
+		uint8_t calendar = program.calendar;
+		json_object(json, "calendar");
+		if ((calendar & 0x80) == 0)
+		{
+			json_string(json, "type", "weekdays");
+			json_array(json, "weekdays");
+			for (uint8_t day = 0; day < 7; ++day)
+				if (calendar & (1 << day))
+					json_string(json, nullptr, weekdays[day]);
+			json_arrayEnd(json);
+		}
+		else if ((calendar >> 6) == 0b10)
+		{
+			json_string(json, "type", "interval");
+			json_number(json, "days", ((calendar >> 3) & 0x07) + 1);
+			json_number(json, "offset", calendar & 0x07);
+		}
+		else if ((calendar >> 5) == 0b110)
+		{
+			json_string(json, "type", (calendar & 0x10) ? "odd" : "even");
+		}
+		json_objectEnd(json);
+
+		// run times in minutes
+		json_array(json, "run_times");
+		for (size_t station = 0; station < 8; ++station)
+			json_number(json, nullptr, program.run_times[station]);
+		json_arrayEnd(json);
+
+		json_objectEnd(json);
+	}
+	json_arrayEnd(json);
+	json_objectEnd(json);
+	apiSend(request, 200, json, apiVersionHeaders);
+}
+
+void web_apiPrograms(AsyncWebServerRequest* request)
+{
+	bool fresh = true;
+	for (uint8_t n = 0; n < 8; ++n)
+		fresh = fresh && unitFresh(api_programs_read[n], unit_programs_max_age);
+
+	if (fresh)
+	{
+		apiPrograms(request);
+		return;
+	}
+
+	apiRequest(request, [](AsyncWebServerRequest* request)
+	{
+		for (uint8_t n = 0; n < 8; ++n)
+		{
+			uint8_t packet[] = { 0xB5, n };
+			if (!readUnit(packet, sizeof(packet), &api_programs[n], sizeof(api_programs[n]), sizeof(api_programs[n]), api_programs_read[n], unit_programs_max_age))
+			{
+				if (request)
+					apiUnitError(request);
+				return;
+			}
+		}
+
+		if (request)
+			apiPrograms(request);
+	});
+}
+
+void web_apiTime(AsyncWebServerRequest* request)
+{
+	apiRequest(request, [](AsyncWebServerRequest* request)
+	{
+		int64_t unit_time, system_time;
+		int8_t calibration;
+		bool read = readUnitTime(unit_time, system_time, calibration);
+		if (!request)
+			return;
+
+		if (!read)
+		{
+			apiUnitError(request);
+			return;
+		}
+
+		auto format_time = [](char* str, int64_t us)
+		{
+			time_t seconds = time_t(us / 1000000);
+			strftime(str, 24, "%Y-%m-%dT%H:%M:%S", gmtime(&seconds));
+			sprintf(str + strlen(str), ".%03uZ", unsigned(us / 1000 % 1000));
 		};
+
+		char unit[32], system[32];
+		format_time(unit, unit_time);
+		format_time(system, system_time);
+
+		json_t json;
+		json_begin(json, api_buffer, sizeof(api_buffer));
+		json_object(json);
+		json_string(json, "unit", unit);
+		json_string(json, "system", system);
+		json_number(json, "offset_ms", long((unit_time - system_time) / 1000));
+		json_number(json, "calibration", calibration);
+		json_objectEnd(json);
+
+		// both times change all the time, the response isn't versioned
+		apiSend(request, 200, json, [](AsyncWebServerResponse* response)
+		{
+			response->addHeader("Cache-Control", "no-store");
+		});
+	});
+}
+
+void web_apiStartProgram(AsyncWebServerRequest* request)
+{
+	long program = request->arg("program").toInt();
+	if (program < 1 || program > 8)
+	{
+		apiError(request, 400, "program out of range");
+		return;
+	}
+
+	apiCommand(request, { 0xA0, uint8_t(program - 1) });
+}
+
+void web_apiStartStations(AsyncWebServerRequest* request)
+{
+	// run times are in minutes, stations not given aren't started
+	std::vector<uint8_t> packet(9);
+	packet[0] = 0xA1;
+	for (size_t n = 0; n < 8; ++n)
+	{
+		char name[12];
+		sprintf(name, "station_%u", unsigned(n + 1));
+
+		long run_time = request->arg(name).toInt();
+		if (run_time < 0 || run_time > 255)
+		{
+			apiError(request, 400, "run time out of range");
+			return;
+		}
+		packet[n + 1] = uint8_t(run_time);
+	}
+
+	apiCommand(request, packet);
+}
+
+void web_apiStopStations(AsyncWebServerRequest* request)
+{
+	apiCommand(request, { 0xA2 });
+}
+
+void web_apiSeasonalAdjustment(AsyncWebServerRequest* request)
+{
+	long adjustment = request->arg("adjustment").toInt();
+	if (adjustment < 1 || adjustment > 15)
+	{
+		apiError(request, 400, "adjustment out of range");
+		return;
+	}
+
+	apiCommand(request, { 0xA3, uint8_t(adjustment) });
+}
+
+void web_apiUpdateTime(AsyncWebServerRequest* request)
+{
+	apiRequest(request, [](AsyncWebServerRequest* request)
+	{
+		updateUnitTime();
+		api_unit_info_read.valid = false;
+
+		if (request)
+			apiOk(request);
+	});
+}
+
+// firmware is collected while it's uploaded and written by a job when the upload is complete,
+// another upload isn't taken until then
+static uint8_t firmware_data[16384];
+static size_t firmware_size = 0;
+static bool firmware_ok = false;
+static bool firmware_queued = false;
+
+void web_uploadFirmwareData(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final)
+{
+	if (firmware_queued)
+		return;
+
+	if (index == 0)
+	{
+		firmware_size = 0;
+		firmware_ok = true;
+	}
+
+	if (index != firmware_size || firmware_size + len > sizeof(firmware_data))
+	{
+		// not enough space in data buffer
+		firmware_ok = false;
+		return;
+	}
+
+	memcpy(firmware_data + firmware_size, data, len);
+	firmware_size += len;
+}
+
+void web_uploadFirmware(AsyncWebServerRequest* request)
+{
+	if (firmware_queued || !firmware_ok)
+	{
+		request->send(500, "text/plain", "Upload error!");
+		return;
+	}
+
+	firmware_queued = true;
+	bool queued = queueRequest(request, [](AsyncWebServerRequest* request)
+	{
+		// signal remote unit to prepare, it's going to be reset
+		uint8_t packet[] = { 0xB0 };
 		packet_send(packet, sizeof(packet));
+
+		bool uploaded = firmwareUpload(firmware_data, firmware_size);
+		firmware_queued = false;
+		firmware_ok = false;
+
+		if (!request)
+			return;
+
+		if (uploaded)
+			redirect(request, "/");
+		else
+			request->send(500, "text/plain", "Upload error!");
+	});
+
+	if (!queued)
+	{
+		firmware_queued = false;
+		request->send(503, "text/plain", "Busy");
+	}
+}
+
+int64_t systemTime()
+{
+	timeval tv;
+	gettimeofday(&tv, nullptr);
+	return int64_t(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+bool readUnitTime(int64_t& unit_time, int64_t& system_time, int8_t& calibration)
+{
+	struct __attribute__((packed))
+	{
+		uint8_t year;
+		uint8_t month;
+		uint8_t day;
+		uint8_t hours;
+		uint8_t minutes;
+		uint8_t seconds;
+		uint16_t milliseconds;
+		int8_t calibration;
+	}
+	unit_time_info;
+
+	// the unit takes its time right after the request packet ends with 200us clock timeout
+	uint8_t packet[] = { 0xB3 };
+	if (!packet_send(packet, sizeof(packet)))
+		return false;
+
+	system_time = systemTime() + 200;
+
+	if (!packet_receive((uint8_t*)&unit_time_info, sizeof(unit_time_info)))
+		return false;
+
+	// system time zone is UTC, so mktime doesn't shift the unit's local time
+	tm local_time = {};
+	local_time.tm_year = unit_time_info.year + 100;
+	local_time.tm_mon = unit_time_info.month - 1;
+	local_time.tm_mday = unit_time_info.day;
+	local_time.tm_hour = unit_time_info.hours;
+	local_time.tm_min = unit_time_info.minutes;
+	local_time.tm_sec = unit_time_info.seconds;
+
+	unit_time = (int64_t(mktime(&local_time)) - time_offset) * 1000000 + int64_t(unit_time_info.milliseconds) * 1000;
+	calibration = unit_time_info.calibration;
+	return true;
+}
+
+void setUnitTime()
+{
+	// packet is composed after the unit accepts the transfer, so its waiting doesn't affect the time
+	if (!packet_send_begin())
+		return;
+
+	uint8_t packet[9] = { 0xA5 };
+
+	// the unit gets the packet after the data transfer and 200us clock timeout that ends the packet
+	int64_t arrival = systemTime() + packet_transfer_time(sizeof(packet)) + 200;
+
+	// the unit waits for the next whole second and sets it then
+	time_t target = time_t(arrival / 1000000) + 1;
+	uint16_t delay_ms = uint16_t((int64_t(target) * 1000000 - arrival) / 1000);
+
+	time_t local_time = target + time_offset;
+	tm* gm_time = gmtime(&local_time);
+
+	packet[1] = uint8_t(gm_time->tm_year % 100);
+	packet[2] = uint8_t(gm_time->tm_mon + 1);
+	packet[3] = uint8_t(gm_time->tm_mday);
+	packet[4] = uint8_t(gm_time->tm_hour);
+	packet[5] = uint8_t(gm_time->tm_min);
+	packet[6] = uint8_t(gm_time->tm_sec);
+	packet[7] = uint8_t(delay_ms);
+	packet[8] = uint8_t(delay_ms >> 8);
+
+	if (packet_send_data(packet, sizeof(packet)))
+	{
+		sync_time = int64_t(target) * 1000000;
+		sync_offset = 0;
+	}
+}
+
+void updateUnitTime()
+{
+	// wait for SNTP to set the system time, no longer than 10s
+	const time_t valid_time = 1609459200; // 2021-01-01
+	unsigned long wait_start = millis();
+	while (time(nullptr) < valid_time && (millis() - wait_start) < 10000)
+		delay(100);
+
+	if (time(nullptr) < valid_time)
+		return;
+
+	int64_t unit_time, system_time;
+	int8_t calibration;
+	if (readUnitTime(unit_time, system_time, calibration))
+	{
+		int64_t offset = unit_time - system_time;
+
+		// drift since the last sync is measured over at least an hour to get fine enough resolution
+		int64_t elapsed = system_time - sync_time;
+		if (sync_time != 0 && elapsed >= 3600000000LL)
+		{
+			// positive drift means the unit clock runs fast, so the calibration is lowered
+			float drift = float(offset - sync_offset) / float(elapsed) * 1e6f;
+			long new_calibration = constrain(calibration - lroundf(drift / calibration_step), -128L, 127L);
+			if (new_calibration != calibration)
+			{
+				uint8_t packet[] = { 0xA6, uint8_t(int8_t(new_calibration)) };
+				packet_send(packet, sizeof(packet));
+			}
+		}
+
+		if (offset > -50000 && offset < 50000)
+		{
+			// unit time is still accurate, it's not written, just taken as a new reference for the drift
+			sync_time = system_time;
+			sync_offset = offset;
+			return;
+		}
 	}
 
-	ntp_client.end();
+	setUnitTime();
 }
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+#
+#   https://github.com/gashtaan/hunter-xcore-firmware
+#
+#   Copyright (C) 2021, Michal Kovacik
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License version 3, as
+#   published by the Free Software Foundation.
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+# Generates gzipped static assets of the web pages (web/*) as flash arrays served by the module as they are.
+#
+# usage: web_assets.py [web directory] [web_assets.h]
+
+import gzip
+import os
+import re
+import sys
+
+TYPES = {
+	'.css': 'text/css',
+	'.js': 'application/javascript',
+	'.svg': 'image/svg+xml',
+	'.ico': 'image/x-icon',
+}
+
+
+def main():
+	base = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+	web_path = sys.argv[1] if len(sys.argv) > 1 else os.path.join(base, 'web')
+	header_path = sys.argv[2] if len(sys.argv) > 2 else os.path.join(base, 'web_assets.h')
+
+	assets = []
+	for name in sorted(os.listdir(web_path)):
+		extension = os.path.splitext(name)[1]
+		if extension not in TYPES:
+			sys.exit('%s: unknown type of asset' % name)
+
+		with open(os.path.join(web_path, name), 'rb') as f:
+			data = f.read()
+
+		# no time stamp in the header, so the output changes only with the asset
+		assets.append((name, TYPES[extension], len(data), gzip.compress(data, 9, mtime=0)))
+
+	out = []
+	out.append('// generated by tools/web_assets.py from web/*, do not edit')
+	out.append('')
+	out.append('#pragma once')
+	out.append('')
+	out.append('struct web_asset_t')
+	out.append('{')
+	out.append('\tconst char* uri;')
+	out.append('\tconst char* type;')
+	out.append('\tconst uint8_t* data; // gzipped, in flash')
+	out.append('\tsize_t size;')
+	out.append('};')
+	for name, type, size, data in assets:
+		symbol = re.sub(r'\W', '_', name)
+		out.append('')
+		out.append('// %s, %d bytes gzipped from %d' % (name, len(data), size))
+		out.append('static const uint8_t web_asset_%s[] PROGMEM =' % symbol)
+		out.append('{')
+		for n in range(0, len(data), 16):
+			out.append('\t' + ' '.join('0x%02X,' % byte for byte in data[n:n + 16]))
+		out.append('};')
+	out.append('')
+	out.append('static const web_asset_t web_assets[] =')
+	out.append('{')
+	for name, type, size, data in assets:
+		symbol = re.sub(r'\W', '_', name)
+		out.append('\t{ "/%s", "%s", web_asset_%s, sizeof(web_asset_%s) },' % (name, type, symbol, symbol))
+	out.append('};')
+
+	with open(header_path, 'w') as f:
+		f.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+	main()
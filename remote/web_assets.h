@@ -0,0 +1,34 @@
+// generated by tools/web_assets.py from web/*, do not edit
+
+#pragma once
+
+struct web_asset_t
+{
+	const char* uri;
+	const char* type;
+	const uint8_t* data; // gzipped, in flash
+	size_t size;
+};
+
+// style.css, 205 bytes gzipped from 341
+static const uint8_t web_asset_style_css[] PROGMEM =
+{
+	0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6D, 0x8E, 0x4D, 0x0A, 0x02, 0x31,
+	0x0C, 0x46, 0xF7, 0x9E, 0x22, 0xE0, 0xD6, 0x8A, 0x3F, 0xE8, 0xA2, 0x73, 0x9A, 0x4E, 0xD3, 0x4E,
+	0x03, 0xED, 0x64, 0x68, 0x03, 0x8E, 0x88, 0x77, 0xB7, 0x55, 0x47, 0x14, 0xDC, 0x25, 0xF9, 0xF2,
+	0x5E, 0xD2, 0x33, 0x5E, 0xE1, 0x06, 0x9E, 0x47, 0x51, 0xDE, 0x24, 0x8A, 0x57, 0x0D, 0xC5, 0x8C,
+	0x45, 0x15, 0x97, 0xC9, 0x77, 0x90, 0x4C, 0x1E, 0x68, 0xD4, 0xB0, 0x77, 0xA9, 0x35, 0xB3, 0xBA,
+	0x10, 0x4A, 0xD0, 0x70, 0x3C, 0xB7, 0xC1, 0x7D, 0x15, 0x72, 0xA5, 0x7B, 0xCE, 0xE8, 0xB2, 0x86,
+	0x5D, 0xF7, 0x2E, 0x95, 0xF0, 0x54, 0x99, 0x69, 0x86, 0xC2, 0x91, 0x10, 0xD6, 0xD6, 0xDA, 0x1F,
+	0x57, 0x5B, 0xBD, 0xAF, 0x3C, 0xE7, 0x54, 0xF1, 0x65, 0xBE, 0xDB, 0x9E, 0x96, 0x44, 0x4C, 0x1F,
+	0xDD, 0xC7, 0xAC, 0x2C, 0xC7, 0x68, 0xA6, 0xE2, 0x34, 0x2C, 0x55, 0xF7, 0x97, 0x0A, 0x1B, 0x10,
+	0xAC, 0xD8, 0x64, 0x10, 0x69, 0x1C, 0x5A, 0x78, 0x68, 0xE1, 0xF6, 0xF9, 0xED, 0x5B, 0xD6, 0xB3,
+	0x08, 0xA7, 0x9F, 0xF7, 0x10, 0xB1, 0x03, 0x71, 0xB3, 0x28, 0x13, 0x69, 0xA8, 0xD2, 0x4C, 0x43,
+	0x90, 0x97, 0x52, 0x7B, 0xCA, 0x45, 0x94, 0x0D, 0x14, 0xB1, 0xE9, 0xBF, 0xFB, 0x7A, 0xEA, 0x9B,
+	0x8A, 0xCE, 0x3F, 0xA1, 0x07, 0xB8, 0x89, 0x7B, 0x18, 0x55, 0x01, 0x00, 0x00,
+};
+
+static const web_asset_t web_assets[] =
+{
+	{ "/style.css", "text/css", web_asset_style_css, sizeof(web_asset_style_css) },
+};
\ No newline at end of file